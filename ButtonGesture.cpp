@@ -0,0 +1,129 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Version 2026.05 by Dave's Think Tank
+
+    - Click / double-click / hold recognizer (see ButtonGesture.h)
+
+ */
+
+#include <Arduino.h>
+#include "RPU_Config.h"
+#include "RPU.h"
+#include "ButtonGesture.h"
+
+
+ButtonGesture::ButtonGesture() {
+  setup(SWITCH_STACK_EMPTY);
+}
+
+
+void ButtonGesture::setup(byte switchNum, unsigned int doubleClickTime, unsigned int holdTime, unsigned int repeatTime, boolean speculativeClick) {
+  this->switchNum = switchNum;
+  this->doubleClickTime = doubleClickTime;
+  this->holdTime = holdTime;
+  this->repeatTime = repeatTime;
+  speculative = speculativeClick;
+  reset();
+}
+
+
+void ButtonGesture::setSwitch(byte switchNum) {
+  if (switchNum == this->switchNum) return;
+  this->switchNum = switchNum;
+  reset();
+}
+
+
+void ButtonGesture::setSpeculativeClick(boolean speculativeClick) {
+  speculative = speculativeClick;
+}
+
+
+// Forgets any click or hold in progress (the settings are kept)
+void ButtonGesture::reset() {
+  pressTime = 0;
+  lastClickTime = 0;
+  lastRepeatTime = 0;
+  down = false;
+  clickPending = false;
+  clickGiven = false;
+  holdReported = false;
+  pressGestures = GESTURE_NONE;
+}
+
+
+void ButtonGesture::press(unsigned long currentTime) {
+  pressGestures = GESTURE_NONE;
+  down = true;
+  holdReported = false;
+  pressTime = currentTime;
+  lastRepeatTime = currentTime;
+
+  if (doubleClickTime == 0) {
+    pressGestures = GESTURE_CLICK;
+    return;
+  }
+
+  if (lastClickTime != 0 && (currentTime - lastClickTime) < doubleClickTime) {
+    // Second press - take back the first click if it was already given
+    pressGestures = GESTURE_DOUBLE_CLICK;
+    if (clickGiven) pressGestures |= GESTURE_UNDO_CLICK;
+    clickPending = false;
+    clickGiven = false;
+    lastClickTime = 0;
+  } else {
+    lastClickTime = currentTime;
+    if (speculative) {
+      pressGestures = GESTURE_CLICK;
+      clickGiven = true;
+    } else {
+      clickPending = true;
+    }
+  }
+}
+
+
+void ButtonGesture::cancelHold() {
+  down = false;
+  holdReported = false;
+}
+
+
+byte ButtonGesture::update(byte curSwitch, unsigned long currentTime) {
+  byte gestures = GESTURE_NONE;
+  if (switchNum == SWITCH_STACK_EMPTY) return gestures;
+
+  if (curSwitch == switchNum) {
+    press(currentTime);
+    gestures = pressGestures;
+  }
+
+  if (down && !RPU_ReadSingleSwitchState(switchNum)) {
+    down = false;
+    holdReported = false;
+  }
+
+  // Once the button is up and the double-click window has passed, the click stands
+  if (!down && lastClickTime != 0 && (currentTime - lastClickTime) > doubleClickTime) {
+    if (clickPending) gestures |= GESTURE_CLICK;
+    clickPending = false;
+    clickGiven = false;
+    lastClickTime = 0;
+  }
+
+  if (down && holdTime != 0 && !holdReported && (currentTime - pressTime) > holdTime) {
+    gestures |= GESTURE_HOLD;
+    if (clickGiven) gestures |= GESTURE_UNDO_CLICK;
+    holdReported = true;
+    clickPending = false;
+    clickGiven = false;
+    lastClickTime = 0;
+    lastRepeatTime = currentTime;
+  } else if (holdReported && repeatTime != 0 && (currentTime - lastRepeatTime) > repeatTime) {
+    gestures |= GESTURE_REPEAT;
+    lastRepeatTime = currentTime;
+  }
+
+  return gestures;
+}
@@ -0,0 +1,75 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Version 2026.05 by Dave's Think Tank
+
+    - Click / double-click / hold recognizer shared by the self-test and
+      the data entry pages.
+
+    Call update() once per loop with the switch pulled from the switch
+    stack. Presses come from the stack (so they're timed at the edge) and
+    releases are read from the switch matrix. It returns the gestures seen
+    on this pass as GESTURE_* bits.
+
+    With speculative clicks on, GESTURE_CLICK is returned as soon as the
+    button goes down instead of after the double-click window. If that
+    press turns out to be the first half of a double-click or the start of
+    a hold, GESTURE_UNDO_CLICK comes back with it so the page can put back
+    what the click did.
+
+ */
+
+#ifndef BUTTON_GESTURE_H
+#define BUTTON_GESTURE_H
+
+#include <Arduino.h>
+
+#define GESTURE_NONE                  0x00
+#define GESTURE_CLICK                 0x01
+#define GESTURE_DOUBLE_CLICK          0x02
+#define GESTURE_HOLD                  0x04
+#define GESTURE_REPEAT                0x08
+#define GESTURE_UNDO_CLICK            0x10
+
+#define GESTURE_DEFAULT_DOUBLE_CLICK_TIME   400
+#define GESTURE_DEFAULT_HOLD_TIME           1000
+
+class ButtonGesture
+{
+public:
+  ButtonGesture();
+  ~ButtonGesture() {;}
+
+  // doubleClickTime of 0 reports every press as a click right away
+  // holdTime of 0 turns off holds, repeatTime of 0 turns off repeats
+  void setup(byte switchNum, unsigned int doubleClickTime = GESTURE_DEFAULT_DOUBLE_CLICK_TIME,
+             unsigned int holdTime = GESTURE_DEFAULT_HOLD_TIME, unsigned int repeatTime = 0, boolean speculativeClick = false);
+  void setSwitch(byte switchNum);
+  void setSpeculativeClick(boolean speculativeClick);
+  void reset();
+
+  byte update(byte curSwitch, unsigned long currentTime);
+  void press(unsigned long currentTime);
+  // Ignores the rest of the current hold (until the next press)
+  void cancelHold();
+  boolean beingHeld() {return holdReported;}
+  byte getSwitch() {return switchNum;}
+
+private:
+  byte switchNum;
+  boolean speculative;
+  unsigned int doubleClickTime;
+  unsigned int holdTime;
+  unsigned int repeatTime;
+
+  unsigned long pressTime;
+  unsigned long lastClickTime;
+  unsigned long lastRepeatTime;
+  boolean down;
+  boolean clickPending;
+  boolean clickGiven;
+  boolean holdReported;
+  byte pressGestures;
+};
+
+#endif
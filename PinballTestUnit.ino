@@ -12,6 +12,14 @@ Version 2026.05 by Dave's Think Tank
 Changes since version released:
 
 - Switch bounce: clear time in player 2 display if hit time exceeds 500 ms
+- VoiceNotificationDurations moved to PROGMEM
+- New Diagnostics page at the end of the self-tests
+- Drop targets are identified automatically: each coil fires, and if two or more switches open within 300 ms it's recorded as a drop target.
+  If only one switch opens, press primary (drop target) or secondary (not a drop target). Display 3 shows the number of switches that opened.
+- The game ROM is fingerprinted (CRC-32) at startup and shown in displays 3 and 4. Saving a game remembers the fingerprint, so the
+  same machine selects its game automatically next time.
+- Solenoid relay is handed to RPU_SetSolenoidRelay when a game is read, so relay solenoids are grouped by side
+- The background song is ducked once per sound, until the WAV Trigger reports the sound has stopped
 
 Version 2026.05 by Dave's Think Tank
 
@@ -41,6 +49,7 @@ Bugs:
 #include "RPU.h"
 #include "PinballTestUnit.h"
 #include "SelfTestAndAudit.h"
+#include "ButtonGesture.h"
 
 #if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
 #include "SendOnlyWavTrigger.h"
@@ -78,6 +87,7 @@ byte numSounds;
 unsigned int minSound;
 byte soundBoard;
 byte dropTargetID[6];
+unsigned long romCRC = 0; // Fingerprint of the game ROM (0 if it couldn't be read)
 
 byte maxSelectedGame = 99;
 byte maxDisplays = 5;
@@ -94,18 +104,17 @@ boolean switchesVerified = false;
 boolean validGame = false;
 boolean relayStage = false;
 
-boolean upDoubleClick = false;
-boolean downDoubleClick = false;
-boolean upBeingHeld;
-boolean downBeingHeld;
-unsigned long LastUpPress = 0;
-unsigned long LastDownPress = 0;
-unsigned long LastUpTestTime = 0;
-unsigned long LastDownTestTime = 0;
 byte upswitch;
 byte downswitch;
 boolean upHold, downHold;
-unsigned long upHoldTime, downHoldTime;
+// Data entry buttons step when pressed and repeat every 333 ms while held
+#define DATA_BUTTON_REPEAT_TIME 333
+ButtonGesture UpButton;
+ButtonGesture DownButton;
+// Minimum sound buttons: click steps by one right away, double-click jumps by 256
+ButtonGesture MinSoundUpButton;
+ButtonGesture MinSoundDownButton;
+unsigned int MinSoundBeforeClick;
 
 boolean doneNothing = true;
 byte curdisp;
@@ -114,11 +123,26 @@ byte dropTarget;
 unsigned long solTimer;
 boolean isDropTarget;
 
+// Drop targets are identified by firing each coil and watching for switches
+// that open shortly afterwards (a bank of targets popping up)
+#define DT_PHASE_WAIT           0   // waiting to fire the next coil
+#define DT_PHASE_WATCH          1   // coil fired, watching the switches
+#define DT_PHASE_CONFIRM        2   // only one switch opened, so ask
+#define DT_WATCH_TIME           300
+#define DT_NEXT_COIL_TIME       1500
+#define DT_CONFIRM_TIMEOUT      10000
+byte dtPhase;
+byte dtSwitchesBefore[RPU_SWITCH_MATRIX_BYTES];
+byte dtSwitchesOpened;
+
 #if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
 int SoundEffectsNormalVolume = -4;
 int SongDuckedVolume = -20;
 
-void PlaySoundEffect(unsigned int soundEffectNum, int gain = 100);
+// Fallback duck length for a sound that never reports starting
+#define SOUND_EFFECT_DUCK_TIME      1000
+void PlaySoundEffect(unsigned int soundEffectNum, int gain = 100, unsigned long duckTime = SOUND_EFFECT_DUCK_TIME);
+#define PRELOADED_SOUND_NONE    0xFFFF
 #endif
 
 void test(byte val) { // display a test value
@@ -237,6 +261,35 @@ void ReadSelectedGame(unsigned short game) {
     if (soundBoard == 0) minSound = 0;
     SetValidDTData();
   }
+  RPU_SetSolenoidRelay(solenoidRelay);
+}
+
+
+// ################## ROM FINGERPRINT ##################
+
+unsigned long ReadRomCRCFromEEProm(byte game) {
+  unsigned long crc = 0;
+  for (byte count = 4; count > 0; --count)
+    crc = (crc << 8) | RPU_ReadByteFromEEProm(RPU_EEPROM_START_TABLE_DATA + (game * RPU_EEPROM_TABLE_ROW_SIZE) + RPU_EEPROM_ROM_CRC + count - 1);
+  return crc;
+}
+
+// Returns the game row saved with this ROM, or 0xFF
+byte FindGameByRomCRC(unsigned long crc) {
+  for (byte game = 0; game <= maxSelectedGame; ++game)
+    if (ReadRomCRCFromEEProm(game) == crc) return game;
+  return 0xFF;
+}
+
+// Selects the game saved with the ROM in the machine
+void IdentifyGameByRom() {
+#ifdef RPU_GAME_ROM_START
+  romCRC = RPU_GetROMCRC32(RPU_GAME_ROM_START, RPU_GAME_ROM_SIZE);
+  if (romCRC == 0) return;
+
+  byte game = FindGameByRomCRC(romCRC);
+  if (game != 0xFF) selectedGame = game;
+#endif
 }
 
 
@@ -265,6 +318,13 @@ boolean WriteSelectedGame(unsigned short game) {
 
     for (i = 0; i < 6; ++i) 
       RPU_WriteByteToEEProm(RPU_EEPROM_START_TABLE_DATA + (game * RPU_EEPROM_TABLE_ROW_SIZE) + RPU_EEPROM_DROP_TARGET_ID + i, dropTargetID[i]);
+
+    if (romCRC != 0) { // Remember which ROM this game was saved with (and only for this game)
+      for (byte otherGame = 0; otherGame <= maxSelectedGame; ++otherGame)
+        if (otherGame != game && ReadRomCRCFromEEProm(otherGame) == romCRC)
+          RPU_WriteULToEEProm(RPU_EEPROM_START_TABLE_DATA + (otherGame * RPU_EEPROM_TABLE_ROW_SIZE) + RPU_EEPROM_ROM_CRC, 0);
+      RPU_WriteULToEEProm(RPU_EEPROM_START_TABLE_DATA + (game * RPU_EEPROM_TABLE_ROW_SIZE) + RPU_EEPROM_ROM_CRC, romCRC);
+    }
     }
   return true;
 }
@@ -277,11 +337,17 @@ int RunSelfTest(int curState, boolean curStateChanged) {
 
   if (curState >= MACHINE_STATE_TEST_DONE) {
     returnState = RunBaseSelfTest(returnState, curStateChanged, CurrentTime, primarySwitch, secondarySwitch, endSwitch); 
-    if (returnState >= 10000) { // Fudged to play sounds in the main program!
-      StopAudio();
-      PlaySoundEffect(returnState - 10000);
+    if (returnState >= 20000) { // Load the next sound (paused) while this one plays
+      PreloadSoundEffect(returnState - 20000);
+      returnState = MACHINE_STATE_TEST_SOUNDS;
+    }
+    else if (returnState >= 10000) { // Fudged to play sounds in the main program!
+      PlayTestSoundEffect(returnState - 10000);
       returnState = MACHINE_STATE_TEST_SOUNDS;
     }
+    else if (returnState != MACHINE_STATE_TEST_SOUNDS) {
+      PreloadSoundEffect(PRELOADED_SOUND_NONE);
+    }
   }
   else {
     returnState = MACHINE_STATE_SELECT_GAME;
@@ -291,6 +357,16 @@ int RunSelfTest(int curState, boolean curStateChanged) {
 
 
 
+// #################### Up / Down Buttons ####################
+void UpdateUpDownHolds(byte curSwitch, byte upSwitchNum, byte downSwitchNum) {
+  UpButton.setSwitch(upSwitchNum);
+  DownButton.setSwitch(downSwitchNum);
+  upHold = (UpButton.update(curSwitch, CurrentTime) & (GESTURE_HOLD | GESTURE_REPEAT)) != 0;
+  downHold = (DownButton.update(curSwitch, CurrentTime) & (GESTURE_HOLD | GESTURE_REPEAT)) != 0;
+}
+
+
+
 // #################### Select Game ####################
 int SelectGame(int curState, boolean curStateChanged) {
   
@@ -331,43 +407,19 @@ int SelectGame(int curState, boolean curStateChanged) {
 
   if (curSwitch == SW_SELF_TEST_SWITCH) curSwitch = SWITCH_STACK_EMPTY;
 
-  upHold = false;
-  if (upswitch != SWITCH_STACK_EMPTY) { // determine if up switch being held
-    if (curSwitch == upswitch) // set time up switch hit if up switch hit
-      upHoldTime = CurrentTime;
-    
-    if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(upswitch)) // zero out time hit if up switch released
-      upHoldTime = 0;
-
-    if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-      upHold = true;
-      upHoldTime = CurrentTime;
-    }
-  }
-
-  downHold = false;
-  if (downswitch != SWITCH_STACK_EMPTY) { // determine if down switch being held
-    if (curSwitch == downswitch) // same for down switch
-      downHoldTime = CurrentTime;
-    
-    if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(downswitch))
-      downHoldTime = 0;
-
-    if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-      downHold = true;
-      downHoldTime = CurrentTime;
-    }
-  }
+  UpdateUpDownHolds(curSwitch, upswitch, downswitch);
 
   if (curSwitch != SWITCH_STACK_EMPTY || upHold || downHold) {
     doneNothing = false;
     if (upswitch == SWITCH_STACK_EMPTY) {
       upswitch = curSwitch;
-      upHoldTime = CurrentTime;
+      UpButton.setSwitch(upswitch);
+      UpButton.press(CurrentTime);
     }
     else if (downswitch == SWITCH_STACK_EMPTY && curSwitch != upswitch) {
       downswitch = curSwitch;
-      downHoldTime = CurrentTime;
+      DownButton.setSwitch(downswitch);
+      DownButton.press(CurrentTime);
     }
 
     if (curSwitch == upswitch || upHold) {
@@ -548,25 +600,7 @@ int LampData(int curState, boolean curStateChanged) {
     return returnState += 1; 
   }
 
-  upHold = false;
-  if (curSwitch == primarySwitch) // set time up switch hit if up switch hit
-    upHoldTime = CurrentTime;
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) // zero out time hit if up switch released
-    upHoldTime = 0;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-    upHold = true;
-    upHoldTime = CurrentTime;
-  }
-
-  downHold = false;
-  if (curSwitch == secondarySwitch) // same for down switch
-    downHoldTime = CurrentTime;
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch))
-    downHoldTime = 0;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-    downHold = true;
-    downHoldTime = CurrentTime;
-  }
+  UpdateUpDownHolds(curSwitch, primarySwitch, secondarySwitch);
 
   if (curSwitch == primarySwitch || upHold) {
     numLamps += 1;
@@ -613,25 +647,7 @@ int SolenoidData(int curState, boolean curStateChanged) {
     RPU_SetDisplay(1, solenoidRelay, true, 2);
   }
 
-  upHold = false;
-  if (curSwitch == primarySwitch) // set time up switch hit if up switch hit
-    upHoldTime = CurrentTime;
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) // zero out time hit if up switch released
-    upHoldTime = 0;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-    upHold = true;
-    upHoldTime = CurrentTime;
-  }
-
-  downHold = false;
-  if (curSwitch == secondarySwitch) // same for down switch
-    downHoldTime = CurrentTime;
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch))
-    downHoldTime = 0;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-    downHold = true;
-    downHoldTime = CurrentTime;
-  }
+  UpdateUpDownHolds(curSwitch, primarySwitch, secondarySwitch);
   if (relayStage) {
      if (curSwitch == primarySwitch || upHold) {
       solenoidRelay += 1;
@@ -682,25 +698,7 @@ int SwitchData(int curState, boolean curStateChanged) {
     return returnState += 1; 
   }
 
-  upHold = false;
-  if (curSwitch == primarySwitch) // set time up switch hit if up switch hit
-    upHoldTime = CurrentTime;
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) // zero out time hit if up switch released
-    upHoldTime = 0;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-    upHold = true;
-    upHoldTime = CurrentTime;
-  }
-
-  downHold = false;
-  if (curSwitch == secondarySwitch) // same for down switch
-    downHoldTime = CurrentTime;
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch))
-    downHoldTime = 0;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-    downHold = true;
-    downHoldTime = CurrentTime;
-  }
+  UpdateUpDownHolds(curSwitch, primarySwitch, secondarySwitch);
 
   if (curSwitch == primarySwitch || upHold) {
     numSwitches += 1;
@@ -738,25 +736,7 @@ int SoundBoard(int curState, boolean curStateChanged) {
     return returnState += 1; 
   }
 
-  upHold = false;
-  if (curSwitch == primarySwitch) // set time up switch hit if up switch hit
-    upHoldTime = CurrentTime;
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) // zero out time hit if up switch released
-    upHoldTime = 0;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-    upHold = true;
-    upHoldTime = CurrentTime;
-  }
-
-  downHold = false;
-  if (curSwitch == secondarySwitch) // same for down switch
-    downHoldTime = CurrentTime;
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch))
-    downHoldTime = 0;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-    downHold = true;
-    downHoldTime = CurrentTime;
-  }
+  UpdateUpDownHolds(curSwitch, primarySwitch, secondarySwitch);
 
   if (curSwitch == primarySwitch || upHold) {
     soundBoard += 1;
@@ -795,25 +775,7 @@ int SoundData(int curState, boolean curStateChanged) {
     return returnState += 1; 
   }
 
-  upHold = false;
-  if (curSwitch == primarySwitch) // set time up switch hit if up switch hit
-    upHoldTime = CurrentTime;
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) // zero out time hit if up switch released
-    upHoldTime = 0;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 333) { // recognize when up switch held for 333 ms
-    upHold = true;
-    upHoldTime = CurrentTime;
-  }
-
-  downHold = false;
-  if (curSwitch == secondarySwitch) // same for down switch
-    downHoldTime = CurrentTime;
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch))
-    downHoldTime = 0;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 333) {
-    downHold = true;
-    downHoldTime = CurrentTime;
-  }
+  UpdateUpDownHolds(curSwitch, primarySwitch, secondarySwitch);
 
 
   if (curSwitch == primarySwitch || upHold) {
@@ -853,91 +815,38 @@ int MinSoundData(int curState, boolean curStateChanged) {
     RPU_SetDisplayBallInPlay(curState + 1, true, true, numCredBIPDigits == 6); // Ball in play displays current test step
     RPU_SetDisplayCredits(0, false, true, numCredBIPDigits == 6);
 
-    LastUpPress = 0;
-    LastDownPress = 0;
-    LastUpTestTime = CurrentTime;
-    LastDownTestTime = CurrentTime;
+    MinSoundUpButton.setup(primarySwitch, GESTURE_DEFAULT_DOUBLE_CLICK_TIME, GESTURE_DEFAULT_HOLD_TIME, 250, true);
+    MinSoundDownButton.setup(secondarySwitch, GESTURE_DEFAULT_DOUBLE_CLICK_TIME, GESTURE_DEFAULT_HOLD_TIME, 250, true);
   }
 
   if (curSwitch == SW_SELF_TEST_SWITCH && (CurrentTime - GetLastSelfTestChangedTime()) > 250) {
     SetLastSelfTestChangedTime(CurrentTime);
     return returnState += 1; 
   }
-  upDoubleClick = false;
-  downDoubleClick = false;
-
-  if (curSwitch == primarySwitch) { // Primary hit. Start clock for double-click and hold. Identify double-click. 
-    curSwitch = SWITCH_STACK_EMPTY;
-    upHoldTime = CurrentTime;
-    if ((CurrentTime - LastUpPress) < 400) {
-      upDoubleClick = true;
-      LastUpPress = 0;
-    }
-    else {
-      LastUpPress = CurrentTime;
-    }
-  }
-
-  if (!RPU_ReadSingleSwitchState(primarySwitch) && CurrentTime - LastUpPress > 400 && LastUpPress != 0) { // Identify primary hit (not double-click)
-    curSwitch = primarySwitch;
-    LastUpPress = 0;
-  }
+  byte upGestures = MinSoundUpButton.update(curSwitch, CurrentTime);
+  byte downGestures = MinSoundDownButton.update(curSwitch, CurrentTime);
 
-  if (upHoldTime != 0 && !RPU_ReadSingleSwitchState(primarySwitch)) { // Identify end of hold
-   upHoldTime = 0;
-  }
+  // A click that turned into a double-click or hold is taken back first
+  if ((upGestures | downGestures) & GESTURE_UNDO_CLICK) minSound = MinSoundBeforeClick;
 
-  upBeingHeld = false;
-  if (upHoldTime != 0 && (CurrentTime - upHoldTime) > 1000) { // identify hold after one second, setup for first hold increase
-    upBeingHeld = true;
-    LastUpPress = 0;
-  }
-  
-  if (curSwitch == secondarySwitch) { // Secondary hit. Start clock for double-click and hold. Identify double-click. 
-    curSwitch = SWITCH_STACK_EMPTY;
-    downHoldTime = CurrentTime;
-    if ((CurrentTime - LastDownPress) < 400) {
-      downDoubleClick = true;
-      LastDownPress = 0;
-    }
-    else {
-      LastDownPress = CurrentTime;
-    }
-  }
-
-  if (!RPU_ReadSingleSwitchState(secondarySwitch) && CurrentTime - LastDownPress > 400 && LastDownPress != 0) { // Identify secondary hit (not double-click)
-    curSwitch = secondarySwitch;
-    LastDownPress = 0;
-  }
-
-  if (downHoldTime != 0 && !RPU_ReadSingleSwitchState(secondarySwitch)) { // Identify end of hold
-   downHoldTime = 0;
-  }
-
-  downBeingHeld = false;
-  if (downHoldTime != 0 && (CurrentTime - downHoldTime) > 1000) { // identify hold after one second, setup for first hold increase
-    downBeingHeld = true;
-    LastDownPress = 0;
-  }
-
-  if (curSwitch == primarySwitch || (upBeingHeld && CurrentTime > LastUpTestTime + 250)) { // Increase minSound on primary or hold
+  if (upGestures & (GESTURE_CLICK | GESTURE_HOLD | GESTURE_REPEAT)) { // Increase minSound on primary or hold
+    if (upGestures & GESTURE_CLICK) MinSoundBeforeClick = minSound;
     minSound += 1;
-    LastUpTestTime = CurrentTime;
   }
   
-  if (curSwitch == secondarySwitch || (downBeingHeld && CurrentTime > LastDownTestTime + 250)) { // Decrease minSound on secondary or hold
-    LastDownTestTime = CurrentTime;
+  if (downGestures & (GESTURE_CLICK | GESTURE_HOLD | GESTURE_REPEAT)) { // Decrease minSound on secondary or hold
+    if (downGestures & GESTURE_CLICK) MinSoundBeforeClick = minSound;
     if (minSound >= 1) 
       minSound -= 1;
     else
     minSound = 0;
   }
 
-  if (upDoubleClick) {
+  if (upGestures & GESTURE_DOUBLE_CLICK) {
     minSound = 256 * (int) ((minSound + 256) / 256); // Increase minSound by 256 on primary double-click
   }
   
-  if (downDoubleClick) {
+  if (downGestures & GESTURE_DOUBLE_CLICK) {
     if (minSound >= 1) 
       minSound -= 1;
     else
@@ -962,7 +871,8 @@ int IdentifyDropTargets(int curState, boolean curStateChanged) {
     RPU_TurnOffAllLamps();
 
     dropTarget = 99;
-    solTimer = CurrentTime - 4000;
+    solTimer = CurrentTime - (DT_NEXT_COIL_TIME - 1000);
+    dtPhase = DT_PHASE_WAIT;
     isDropTarget = false;
     SetValidDTData();
     
@@ -983,35 +893,40 @@ int IdentifyDropTargets(int curState, boolean curStateChanged) {
 
   if (dropTarget != 99) { // one second pause before first solenoid fires
     if (curSwitch == primarySwitch) { // Drop target identified: Add to list (only once!)
-      
-      isDropTarget = false;
-      for (i = 0; i < maxDropTargets; ++i) { // Delete identified drop target from list (to ensure added once only)
-        if (dropTargetID[i] == dropTarget)
-          dropTargetID[i] = 0xFF;
-      }
-      for (i = 0; i < maxDropTargets; ++i) { // Add identified drop target to first available spot in list
-        if (dropTargetID[i] == 0xFF) {
-          dropTargetID[i] = dropTarget;
-          isDropTarget = true;
-          i = maxDropTargets; // end search
-        }
-      }
+      SetDropTargetID(dropTarget, true);
       RPU_SetDisplay(1, isDropTarget, true, 2);
-      solTimer = CurrentTime - 4500;
+      if (dtPhase == DT_PHASE_CONFIRM) RPU_SetDisplay(2, dtSwitchesOpened, true, 1); // stop flashing
+      dtPhase = DT_PHASE_WAIT;
+      solTimer = CurrentTime - (DT_NEXT_COIL_TIME - 500);
     }
     if (curSwitch == secondarySwitch) { // Current solenoid identified as NOT a drop target
-      isDropTarget = false;
-      for (i = 0; i < maxDropTargets; ++i) { // Delete identified solenoid from list
-        if (dropTargetID[i] == dropTarget) {
-          dropTargetID[i] = 0xFF;
-        }
-      }
+      SetDropTargetID(dropTarget, false);
       RPU_SetDisplay(1, isDropTarget, true, 2);
-      solTimer = CurrentTime - 4500;
+      if (dtPhase == DT_PHASE_CONFIRM) RPU_SetDisplay(2, dtSwitchesOpened, true, 1); // stop flashing
+      dtPhase = DT_PHASE_WAIT;
+      solTimer = CurrentTime - (DT_NEXT_COIL_TIME - 500);
     }
   }
 
-  if (CurrentTime - solTimer > 5000) {
+  if (dtPhase == DT_PHASE_WATCH && CurrentTime - solTimer > DT_WATCH_TIME) {
+    // Count the switches that were closed before the coil fired and are open now
+    byte switchesNow[RPU_SWITCH_MATRIX_BYTES];
+    RPU_GetSwitchMatrixSnapshot(switchesNow);
+    dtSwitchesOpened = 0;
+    for (i = 0; i < RPU_SWITCH_MATRIX_BYTES; ++i) dtSwitchesOpened += RPU_PopCount(dtSwitchesBefore[i] & ~switchesNow[i]);
+    RPU_SetDisplay(2, dtSwitchesOpened, true, 1);
+
+    if (dtSwitchesOpened >= 2) { // A bank of targets reset
+      SetDropTargetID(dropTarget, true);
+      dtPhase = DT_PHASE_WAIT;
+    } else if (dtSwitchesOpened == 1) { // Could be a single target, or a kicker - ask
+      dtPhase = DT_PHASE_CONFIRM;
+    } else { // Nothing reset (or the targets were already up), so leave the list alone
+      dtPhase = DT_PHASE_WAIT;
+    }
+  }
+
+  if ((dtPhase == DT_PHASE_WAIT && CurrentTime - solTimer > DT_NEXT_COIL_TIME) || (dtPhase == DT_PHASE_CONFIRM && CurrentTime - solTimer > DT_CONFIRM_TIMEOUT)) {
     solTimer = CurrentTime;
     dropTarget += 1;
     if (dropTarget > numSolenoids) dropTarget = 0;
@@ -1022,15 +937,37 @@ int IdentifyDropTargets(int curState, boolean curStateChanged) {
 
     RPU_SetDisplay(0, dropTarget, true, 2);
     RPU_SetDisplay(1, isDropTarget, true, 2);
+    RPU_SetDisplayBlank(2, 0x00);
 
+    RPU_GetSwitchMatrixSnapshot(dtSwitchesBefore);
     RPU_PushToSolenoidStack(dropTarget, 5, false, solenoidRelay);
+    dtPhase = DT_PHASE_WATCH;
   }
   RPU_SetDisplay(0, dropTarget, true, 2);
   RPU_SetDisplayFlash(1, isDropTarget, CurrentTime, 250, 2);
+  if (dtPhase == DT_PHASE_CONFIRM) RPU_SetDisplayFlash(2, dtSwitchesOpened, CurrentTime, 250, 1);
   return returnState;
 }
 
 
+// Adds or removes a solenoid from the drop target list (only once!)
+void SetDropTargetID(byte solenoid, boolean addDropTarget) {
+  isDropTarget = false;
+  for (i = 0; i < maxDropTargets; ++i) { // Delete solenoid from list (to ensure added once only)
+    if (dropTargetID[i] == solenoid)
+      dropTargetID[i] = 0xFF;
+  }
+  if (!addDropTarget) return;
+  for (i = 0; i < maxDropTargets; ++i) { // Add drop target to first available spot in list
+    if (dropTargetID[i] == 0xFF) {
+      dropTargetID[i] = solenoid;
+      isDropTarget = true;
+      i = maxDropTargets; // end search
+    }
+  }
+}
+
+
 
 // #################### LOOP ####################
 void loop() {
@@ -1038,6 +975,8 @@ void loop() {
   RPU_DataRead(0);
 
   CurrentTime = millis();
+  unsigned long loopStart = micros();
+  int loopMachineState = MachineState;
   int newMachineState = MachineState;
 
   if (MachineState<0) {
@@ -1070,12 +1009,20 @@ void loop() {
   if (newMachineState!=MachineState) {
     MachineState = newMachineState;
     MachineStateChanged = true;
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+    RPU_RecordSwitchMarker((byte)MachineState);
+#endif
   } else {
     MachineStateChanged = false;
   }
 
   RPU_ApplyFlashToLamps(CurrentTime);
+  RPU_UpdateLampShow(CurrentTime);
   RPU_UpdateTimedSolenoidStack(CurrentTime, solenoidRelay);
+#if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
+  ServiceSongDucking();
+#endif
+  RecordLoopTime(loopMachineState, micros() - loopStart);
 }
 
 // #################### SETUP ####################
@@ -1086,6 +1033,8 @@ void setup() {
   RPU_InitializeMPU(RPU_CMD_BOOT_ORIGINAL_IF_CREDIT_RESET | RPU_CMD_BOOT_ORIGINAL_IF_NOT_SWITCH_CLOSED | RPU_CMD_PERFORM_MPU_TEST, SW_GAME_BUTTON);
   RPU_DisableSolenoidStack();
   RPU_SetDisableFlippers(true);
+  UpButton.setup(SWITCH_STACK_EMPTY, 0, DATA_BUTTON_REPEAT_TIME, DATA_BUTTON_REPEAT_TIME);
+  DownButton.setup(SWITCH_STACK_EMPTY, 0, DATA_BUTTON_REPEAT_TIME, DATA_BUTTON_REPEAT_TIME);
 
   // Get all dip variables
   for (i = 0; i < 4; ++i) {
@@ -1096,14 +1045,20 @@ void setup() {
 
   selectedGame = RPU_ReadByteFromEEProm(RPU_EEPROM_SELECTED_GAME); // Start by reading data for most recent selected game
   if (selectedGame > 99) selectedGame = 0;
+  IdentifyGameByRom(); // A game saved with the ROM in this machine wins
   ReadSelectedGame(selectedGame);
   if (!validGame) SetSelectedGameDefaults();
 
   RPU_SetDisplay(0, floor(VERSION_NUMBER), true, 2);
   RPU_SetDisplayCredits(floor(100 * (VERSION_NUMBER + 0.005 - floor(VERSION_NUMBER))), true, true, numCredBIPDigits == 6);
   RPU_SetDisplayBlank(1, 0x00);
-  RPU_SetDisplayBlank(2, 0x00);
-  RPU_SetDisplayBlank(3, 0x00);
+  if (romCRC != 0) { // ROM fingerprint, high and low halves
+    RPU_SetDisplay(2, romCRC >> 16, true);
+    RPU_SetDisplay(3, romCRC & 0xFFFF, true);
+  } else {
+    RPU_SetDisplayBlank(2, 0x00);
+    RPU_SetDisplayBlank(3, 0x00);
+  }
 
   delay(4000);
 
@@ -1114,6 +1069,7 @@ void setup() {
   // WAV Trigger startup at 57600
   wTrig.start();
   wTrig.stopAllTracks();
+  wTrig.setReporting(true);
   delayMicroseconds(10000);
   #endif
 
@@ -1130,6 +1086,25 @@ void setup() {
 
 #if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
 byte CurrentBackgroundSong = SOUND_EFFECT_NONE;
+
+// The background song is ducked while effects and voice notifications play.
+// Each sound takes one hold on the duck, and the song only fades down for
+// the first hold and back up when the last one is released, so 
+// overlapping sounds don't send extra fades over the serial link.
+// With track reporting on, a hold is released when the WAV Trigger says its
+// track has stopped, so the song stays down for as long as the sound really
+// plays. The length given when the hold is taken is only used if the track
+// never reports playing (reports not wired, or a sound shorter than a pass
+// through the loop).
+#define SONG_DUCK_HOLDS_SIZE        8
+#define SONG_DUCK_FADE_DOWN_TIME    500
+#define SONG_DUCK_FADE_UP_TIME      1500
+#define SOUND_EFFECT_MAX_DUCK_TIME  30000
+unsigned int SongDuckHoldTrack[SONG_DUCK_HOLDS_SIZE];
+unsigned long SongDuckHoldExpiry[SONG_DUCK_HOLDS_SIZE];
+boolean SongDuckHoldReported[SONG_DUCK_HOLDS_SIZE];
+byte SongDuckHolds = 0;
+boolean SongDucked = false;
 #endif
 
 void StopAudio() {
@@ -1160,7 +1135,7 @@ void PlayBackgroundSong(byte songNum) {
         wTrig.trackPlayPoly(songNum);
 #endif
         wTrig.trackLoop(songNum, true);
-        wTrig.trackGain(songNum, -4);
+        wTrig.trackGain(songNum, SongDucked ? SongDuckedVolume : SongNormalVolume);
       }
       CurrentBackgroundSong = songNum;
     }
@@ -1173,6 +1148,75 @@ void PlayBackgroundSong(byte songNum) {
 }
 
 
+#if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
+void DuckBackgroundSong(unsigned int trackNum, unsigned long duration) {
+  unsigned long expiry = CurrentTime + duration;
+  byte holdNum;
+  for (holdNum = 0; holdNum < SongDuckHolds; holdNum++) {
+    if (SongDuckHoldTrack[holdNum] == trackNum) break;
+  }
+
+  if (holdNum < SongDuckHolds) {
+    // Retriggered - the track's hold covers it
+    if ((long)(SongDuckHoldExpiry[holdNum] - expiry) < 0) SongDuckHoldExpiry[holdNum] = expiry;
+  } else if (SongDuckHolds < SONG_DUCK_HOLDS_SIZE) {
+    SongDuckHoldTrack[SongDuckHolds] = trackNum;
+    SongDuckHoldExpiry[SongDuckHolds] = expiry;
+    SongDuckHoldReported[SongDuckHolds] = false;
+    SongDuckHolds += 1;
+  } else {
+    // No room - stretch the hold that ends first instead
+    byte firstToExpire = 0;
+    for (byte count = 1; count < SONG_DUCK_HOLDS_SIZE; count++) {
+      if ((long)(SongDuckHoldExpiry[count] - SongDuckHoldExpiry[firstToExpire]) < 0) firstToExpire = count;
+    }
+    if ((long)(SongDuckHoldExpiry[firstToExpire] - expiry) < 0) SongDuckHoldExpiry[firstToExpire] = expiry;
+  }
+
+  if (!SongDucked) {
+    if (CurrentBackgroundSong != SOUND_EFFECT_NONE) wTrig.trackFade(CurrentBackgroundSong, SongDuckedVolume, SONG_DUCK_FADE_DOWN_TIME, 0);
+    SongDucked = true;
+  }
+}
+
+void ServiceSongDucking() {
+  // Reports are read every pass so the serial buffer doesn't overflow
+  wTrig.update();
+  if (SongDuckHolds == 0) return;
+
+  byte count = 0;
+  while (count < SongDuckHolds) {
+    boolean releaseHold = ((long)(CurrentTime - SongDuckHoldExpiry[count]) >= 0);
+    if (wTrig.isTrackPlaying(SongDuckHoldTrack[count])) {
+      if (!SongDuckHoldReported[count]) {
+        // Started - from now on the stop report ends the hold
+        SongDuckHoldReported[count] = true;
+        SongDuckHoldExpiry[count] = CurrentTime + SOUND_EFFECT_MAX_DUCK_TIME;
+        releaseHold = false;
+      }
+    } else if (SongDuckHoldReported[count]) {
+      releaseHold = true;
+    }
+
+    if (releaseHold) {
+      // Move the last hold into this slot
+      SongDuckHolds -= 1;
+      SongDuckHoldTrack[count] = SongDuckHoldTrack[SongDuckHolds];
+      SongDuckHoldExpiry[count] = SongDuckHoldExpiry[SongDuckHolds];
+      SongDuckHoldReported[count] = SongDuckHoldReported[SongDuckHolds];
+    } else {
+      count += 1;
+    }
+  }
+
+  if (SongDuckHolds == 0 && SongDucked) {
+    if (CurrentBackgroundSong != SOUND_EFFECT_NONE) wTrig.trackFade(CurrentBackgroundSong, SongNormalVolume, SONG_DUCK_FADE_UP_TIME, 0);
+    SongDucked = false;
+  }
+}
+#endif
+
+
 
 #ifdef RPU_OS_USE_DASH51
 
@@ -1485,7 +1529,7 @@ inline void StopSoundEffect(byte soundEffectNum) {
 
 #if defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)
 
-void PlaySoundEffect(unsigned int soundEffectNum, int gain) {
+void PlaySoundEffect(unsigned int soundEffectNum, int gain, unsigned long duckTime) {
 
   if (MusicLevel == 0) return;
   if (MusicLevel < 3) {
@@ -1500,9 +1544,42 @@ void PlaySoundEffect(unsigned int soundEffectNum, int gain) {
         SOUND_EFFECT_SPINNER ) wTrig.trackStop(soundEffectNum);
 #endif
   if (gain == 100) gain = SoundEffectsNormalVolume;
+  DuckBackgroundSong(soundEffectNum, duckTime);
   wTrig.trackPlayPoly(soundEffectNum);
   wTrig.trackGain(soundEffectNum, gain);
 }
+
+
+// The sound test has the WAV Trigger load the next track paused while the
+// current one plays, so starting it doesn't wait on the file open
+unsigned int PreloadedSoundEffect = PRELOADED_SOUND_NONE;
+unsigned int TestSoundEffectPlaying = PRELOADED_SOUND_NONE;
+
+void PreloadSoundEffect(unsigned int soundEffectNum) {
+  // Like PlayTestSoundEffect, leave the WAV Trigger alone when it isn't
+  // being used (sound off or built-in sounds only)
+  if (MusicLevel < 3) soundEffectNum = PRELOADED_SOUND_NONE;
+  if (soundEffectNum == PreloadedSoundEffect) return;
+  if (PreloadedSoundEffect != PRELOADED_SOUND_NONE) wTrig.trackStop(PreloadedSoundEffect);
+  PreloadedSoundEffect = soundEffectNum;
+  if (soundEffectNum == PRELOADED_SOUND_NONE) return;
+  wTrig.trackLoad(soundEffectNum);
+  wTrig.trackGain(soundEffectNum, SoundEffectsNormalVolume);
+}
+
+void PlayTestSoundEffect(unsigned int soundEffectNum) {
+  if (soundEffectNum != PreloadedSoundEffect || MusicLevel < 3) {
+    PreloadedSoundEffect = PRELOADED_SOUND_NONE;
+    StopAudio();
+    PlaySoundEffect(soundEffectNum);
+  } else {
+    // Stop what's playing and start the loaded track
+    if (TestSoundEffectPlaying != PRELOADED_SOUND_NONE) wTrig.trackStop(TestSoundEffectPlaying);
+    wTrig.resumeAllInSync();
+    PreloadedSoundEffect = PRELOADED_SOUND_NONE;
+  }
+  TestSoundEffectPlaying = soundEffectNum;
+}
 #endif
 
 
@@ -1515,7 +1592,7 @@ byte VoiceNotificationStackLast;
 unsigned int VoiceNotificationNumStack[VOICE_NOTIFICATION_STACK_SIZE];
 unsigned long NextVoiceNotificationPlayTime;
 
-byte VoiceNotificationDurations[NUM_VOICE_NOTIFICATIONS] = {
+const byte VoiceNotificationDurations[NUM_VOICE_NOTIFICATIONS] PROGMEM = {
   2, 2, 2, 2, 3, 3, 3, 3, 4, 3, 3, 3, 4
 };
 
@@ -1561,11 +1638,8 @@ void QueueNotification(unsigned int soundEffectNum, byte priority) {
 
   // If there's nothing playing, we can play it now
   if (NextVoiceNotificationPlayTime == 0) {
-    if (CurrentBackgroundSong != SOUND_EFFECT_NONE) {
-      wTrig.trackFade(CurrentBackgroundSong, SongDuckedVolume, 500, 0);
-    }
-    NextVoiceNotificationPlayTime = CurrentTime + (unsigned long)(VoiceNotificationDurations[soundEffectNum - SOUND_EFFECT_VP_VOICE_NOTIFICATIONS_START]) * 1000;
-    PlaySoundEffect(soundEffectNum, 2);
+    NextVoiceNotificationPlayTime = CurrentTime + (unsigned long)pgm_read_byte(&VoiceNotificationDurations[soundEffectNum - SOUND_EFFECT_VP_VOICE_NOTIFICATIONS_START]) * 1000;
+    PlaySoundEffect(soundEffectNum, 2, NextVoiceNotificationPlayTime - CurrentTime);
   } else {
     if (priority == 0) {
       PushToNotificationStack(soundEffectNum);
@@ -1581,16 +1655,10 @@ void ServiceNotificationQueue() {
     // Current notification done, see if there's another
     unsigned int nextNotification = PullFirstFromVoiceNotificationStack();
     if (nextNotification != VOICE_NOTIFICATION_STACK_EMPTY) {
-      if (CurrentBackgroundSong != SOUND_EFFECT_NONE) {
-        wTrig.trackFade(CurrentBackgroundSong, SongDuckedVolume, 500, 0);
-      }
-      NextVoiceNotificationPlayTime = CurrentTime + (unsigned long)(VoiceNotificationDurations[nextNotification - SOUND_EFFECT_VP_VOICE_NOTIFICATIONS_START]) * 1000;
-      PlaySoundEffect(nextNotification, 2);
+      NextVoiceNotificationPlayTime = CurrentTime + (unsigned long)pgm_read_byte(&VoiceNotificationDurations[nextNotification - SOUND_EFFECT_VP_VOICE_NOTIFICATIONS_START]) * 1000;
+      PlaySoundEffect(nextNotification, 2, NextVoiceNotificationPlayTime - CurrentTime);
     } else {
-      // No more notifications -- set the volume back up and clear the variable
-      if (CurrentBackgroundSong != SOUND_EFFECT_NONE) {
-        wTrig.trackFade(CurrentBackgroundSong, SongNormalVolume, 1500, 0);
-      }
+      // No more notifications -- the song comes back up when its last duck hold runs out
       NextVoiceNotificationPlayTime = 0;
     }
   }
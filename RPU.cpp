@@ -25,6 +25,29 @@
 
     - Extended RPU_CycleAllDisplays with boolean display8, to allow cycling displays with value 8 only.
 
+    Changes since version released:
+
+    - Switch matrix scan is paced by Timer2 compare interrupts (one strobe step per interrupt) instead of delayMicroseconds() inside the interrupt handlers.
+    - RPU_SetDisplay skips unchanged values and converts to BCD with double dabble instead of a divide per digit.
+    - Display flashing and the display test digit cycle are run by the display interrupt (RPU_SetDisplayBlink, RPU_SetDisplayCycle).
+    - Lamp shows: frames of lamp bank bitmasks in PROGMEM, or built-in row/column/chase shows, written a bank at a time by RPU_UpdateLampShow.
+    - Constant tables (BitShiftValues, BlankingBit, alpha segment tables) are in PROGMEM. Free SRAM is painted at startup so the stack high-water mark can be read back (RPU_GetStackHighWater).
+    - Solenoid stack entries hold a solenoid number and a tick count, so a push of any length takes one entry.
+    - Solenoid relay scheduling: pending fires are grouped by relay side, the relay switches once per group and settles before the next fire (RPU_SetSolenoidRelay, RPU_GetSolenoidRelayFlips).
+    - RPU_DataReadBlock reads consecutive addresses with the bus set up once per chunk (rev 3). RPU_GetROMCRC32 fingerprints a ROM region.
+    - RPU_TestRAM runs a March C- test over MPU RAM through the bus. Each march element goes through RPU_DataReadWriteBlock / RPU_DataFillBlock, which set the bus up once per cell and hold interrupts off a chunk at a time.
+    - Switch debouncing is a vertical counter with a debounce length per switch (RPU_SetSwitchDebounce).
+    - RPU_GetSwitchMatrixSnapshot copies the last complete switch scan, and RPU_PopCount counts bits.
+    - Arch 1 lamps are strobed one bank per Timer2 step, and the longest interrupt chunk and display latency are measured.
+    - Arch 10 reads one switch column per interrupt (no Timer2), so every interrupt costs about the same.
+    - Lamp bank functions (RPU_SetLampBank, RPU_SetLampBankDim, RPU_SetLampBankFlash, RPU_FillAllLamps) set eight lamps per store.
+    - Lamp states are double buffered: RPU_BeginLampFrame / RPU_CommitLampFrame show a set of changes all at once.
+    - S&T and -51 sound bytes are queued and clocked out by Timer3 a phase at a time instead of blocking interrupts, and each byte is fitted between the display and zero-crossing interrupts.
+    - Switch recording (RPU_OS_USE_SWITCH_RECORDING): closures (pulled and seen in the matrix), openings and markers go into a ring that can be dumped to Serial or replayed.
+    - Lamp strobe padding and display latch delay are runtime settings kept in EEPROM, set by hand from the diagnostics page.
+    - Zero-crossing monitor: Timer5 timestamps each crossing for mains frequency, jitter, retrigger and missed-crossing counts; retriggers under half a period are cleared without a scan.
+    - Host build (RPU_OS_HOST_BUILD, see host/): the bus goes to a model of the MPU so the OS can be run on Linux on a virtual clock.
+
  */
 
 
@@ -86,6 +109,9 @@ boolean UsesM6800Processor = false;
 #if !defined(RPU_OS_SWITCH_DELAY_IN_MICROSECONDS) || !defined(RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS)
 #error "Must define RPU_OS_SWITCH_DELAY_IN_MICROSECONDS and RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS in RPU_Config.h"
 #endif
+#if (RPU_OS_SWITCH_DELAY_IN_MICROSECONDS<4) || (RPU_OS_SWITCH_DELAY_IN_MICROSECONDS>512) || (RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS<4) || (RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS>512)
+#error "RPU_OS_SWITCH_DELAY_IN_MICROSECONDS and RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS must be between 4 and 512 (switch strobe timer range)"
+#endif
 
 #elif (RPU_MPU_ARCHITECTURE >= 10) 
 #define RPU_NUM_SOLENOIDS             22
@@ -94,6 +120,9 @@ boolean UsesM6800Processor = false;
 #ifndef INTERRUPT_OCR1A_COUNTER
 #define INTERRUPT_OCR1A_COUNTER         16574
 #endif
+#ifndef RPU_OS_SWITCH_DELAY_IN_MICROSECONDS
+#define RPU_OS_SWITCH_DELAY_IN_MICROSECONDS   12
+#endif
 
 volatile byte BoardLEDs = 0;
 volatile boolean UpDownSwitch = false;
@@ -119,29 +148,105 @@ volatile byte DisplayDigits[5][RPU_OS_NUM_DIGITS];
 volatile byte DisplayDigitEnable[5];
 volatile boolean DisplayOffCycle = false;
 volatile byte CurrentDisplayDigit=0;
-volatile byte LampStates[RPU_NUM_LAMP_BANKS], LampDim1[RPU_NUM_LAMP_BANKS], LampDim2[RPU_NUM_LAMP_BANKS];
+
+// Display animations are run by the display interrupt, so 
+// the loop only has to set them up (see RPU_SetDisplayBlink)
+struct DisplayAnimation {
+  byte blinkMask;               // digits (same bits as DisplayDigitEnable) that blink
+  byte blinkGate;               // mask the interrupt applies to DisplayDigitEnable
+  boolean blinkOn;
+  int blinkPeriodSetting;       // in ms, as requested
+  unsigned short blinkPeriod;   // in display interrupts
+  unsigned short blinkCountdown;
+  byte cycleMask;               // digits that show the cycle sequence
+};
+volatile DisplayAnimation DisplayAnimations[5];
+volatile byte DisplayCycleFirst = 0;
+volatile byte DisplayCycleLast = 9;
+volatile byte DisplayCycleValue = 0;
+int DisplayCyclePeriodSetting = 0;
+volatile unsigned short DisplayCyclePeriod = 0;
+volatile unsigned short DisplayCycleCountdown = 0;
+
+// The public display setters stop animations, these don't
+byte SetDisplayDigits(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude);
+void SetDisplayEnable(int displayNumber, byte bitMask);
+// Lamp states are double buffered. The interrupts show LampStateBuffers[LampFrontBuffer],
+// and LampStates points at the buffer the app writes - normally the front buffer, 
+// but between RPU_BeginLampFrame and RPU_CommitLampFrame it's the back buffer,
+// which the interrupt swaps to the front at the start of its next lamp pass.
+volatile byte LampStateBuffers[2][RPU_NUM_LAMP_BANKS];
+volatile byte *LampStates = LampStateBuffers[0];
+volatile byte LampFrontBuffer = 0;
+volatile boolean LampFramePending = false;
+byte LampFrameDepth = 0;
+volatile byte LampDim1[RPU_NUM_LAMP_BANKS], LampDim2[RPU_NUM_LAMP_BANKS];
 volatile byte LampFlashPeriod[RPU_MAX_LAMPS];
 byte DimDivisor1 = 2;
 byte DimDivisor2 = 3;
 
-volatile byte SwitchesMinus2[NUM_SWITCH_BYTES];
-volatile byte SwitchesMinus1[NUM_SWITCH_BYTES];
+// Switch debouncing is a vertical counter: each switch counts its consecutive
+// closed samples, one bit per plane, so eight switches are counted with each
+// byte operation. A closure is valid on the sample the count reaches that 
+// switch's debounce length (also kept in planes). A length of 2 is the 
+// original (off, on, on) rule.
+#ifndef RPU_OS_SWITCH_DEBOUNCE_PLANES
+#define RPU_OS_SWITCH_DEBOUNCE_PLANES   3
+#endif
+#define SWITCH_DEBOUNCE_MAX_SAMPLES     ((1<<RPU_OS_SWITCH_DEBOUNCE_PLANES)-1)
 volatile byte SwitchesNow[NUM_SWITCH_BYTES];
+// Copy of SwitchesNow made when a whole scan is done (see RPU_GetSwitchMatrixSnapshot)
+volatile byte SwitchesLastScan[NUM_SWITCH_BYTES];
+volatile byte SwitchClosedCount[RPU_OS_SWITCH_DEBOUNCE_PLANES][NUM_SWITCH_BYTES];
+volatile byte SwitchDebounceLength[RPU_OS_SWITCH_DEBOUNCE_PLANES][NUM_SWITCH_BYTES];
 #ifdef RPU_OS_USE_DIP_SWITCHES
 byte DipSwitches[4];
 #endif
 
+// Each entry fires one solenoid for numTicks interrupts, 
+// so a push takes one entry no matter how long it fires
 #if (RPU_OS_HARDWARE_REV>2)
-#define SOLENOID_STACK_SIZE 150
+#define SOLENOID_STACK_SIZE 64
 #else 
-#define SOLENOID_STACK_SIZE 60
+#define SOLENOID_STACK_SIZE 30
 #endif
 #define SOLENOID_STACK_EMPTY 0xFF
+struct SolenoidStackEntry {
+  byte solenoidNumber;
+  byte numTicks;
+};
 volatile byte SolenoidStackFirst;
 volatile byte SolenoidStackLast;
-volatile byte SolenoidStack[SOLENOID_STACK_SIZE];
+volatile SolenoidStackEntry SolenoidStack[SOLENOID_STACK_SIZE];
+
+// Solenoid (A/C) relay scheduling
+// Entries for coils on the relay side are marked with SOLENOID_RELAY_SIDE_C,
+// and the interrupt only fires entries for the side the relay is on. Entries
+// for the current side are pulled forward so the relay switches once per 
+// group, and nothing fires for SolenoidRelaySettleTicks after a switch
+// (RPU_OS_SOLENOID_RELAY_SETTLE_TICKS, defaulted in RPU.h).
+#define SOLENOID_RELAY_NONE     99
+#define SOLENOID_RELAY_SIDE_C   0x80
+byte SolenoidRelayLamp = SOLENOID_RELAY_NONE;
+byte SolenoidRelayBank = 0;
+byte SolenoidRelayBit = 0;
+byte SolenoidRelaySettleTicks = RPU_OS_SOLENOID_RELAY_SETTLE_TICKS;
+volatile byte SolenoidRelaySettleCountdown = 0;
+volatile boolean SolenoidRelaySideC = false;
+volatile unsigned long SolenoidRelayFlips = 0;
 boolean SolenoidStackEnabled = true;
 volatile byte CurrentSolenoidByte = 0xFF;
+// S&T and -51 sound bytes go out through Timer3 on boards that have it
+#if (RPU_MPU_ARCHITECTURE<10) && (defined(RPU_OS_USE_S_AND_T) || defined(RPU_OS_USE_DASH51)) && defined(TCCR3A)
+#define RPU_OS_QUEUED_SOUND_BYTES
+#endif
+// Set while a sound byte is on U11B (see ClockOutSoundPhase)
+volatile boolean SoundTransferActive = false;
+#if (RPU_MPU_ARCHITECTURE<10)
+// Set from the zero-crossing interrupt until its Timer2 strobe sequence 
+// is done (see LockBusBetweenStrobes)
+volatile byte InsideZeroCrossingInterrupt = 0;
+#endif
 volatile byte RevertSolenoidBit = 0x00;
 volatile byte NumCyclesBeforeRevertingSolenoidByte = 0;
 
@@ -312,7 +417,21 @@ TimedSoundEntry TimedSoundStack[TIMED_SOUND_STACK_SIZE] = {0, 0, 0, 0};
  *   
  */
 
-#if (RPU_OS_HARDWARE_REV==1) or (RPU_OS_HARDWARE_REV==2)
+#if defined(RPU_OS_HOST_BUILD)
+
+// Host simulation (host/) - the bus goes to a model of the MPU, and
+// the rest of the OS is built for the configured board
+#include "HostMPU.h"
+
+void RPU_DataWrite(int address, byte data) {
+  HostBusWrite(address, data);
+}
+
+byte RPU_DataRead(int address) {
+  return HostBusRead(address);
+}
+
+#elif (RPU_OS_HARDWARE_REV==1) or (RPU_OS_HARDWARE_REV==2)
 
 #if defined(__AVR_ATmega2560__)
 #error "ATMega requires RPU_OS_HARDWARE_REV of 3, check RPU_Config.h and adjust settings"
@@ -578,6 +697,205 @@ void WaitClockCycle(int numCycles=1) {
   }
 }
 
+// Reads numBytes consecutive addresses. The data pins and R/W are set up once
+// per chunk instead of once per byte, and interrupts are held off for one 
+// chunk at a time so the interrupts can still get to the bus in between.
+#define RPU_OS_HAS_DATA_READ_BLOCK
+#define RPU_DATA_READ_BLOCK_CHUNK   16
+
+void RPU_DataReadBlock(int address, byte *buffer, int numBytes) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+
+    // Set data pins to input
+    DDRH = DDRH & 0x87;
+    DDRB = DDRB & 0x8F;
+    DDRJ = DDRJ & 0xFE;
+
+    // Set R/W to HIGH
+    DDRE = DDRE | 0x08;
+    PORTE = (PORTE | 0x08);
+
+    for (byte count=0; count<chunkSize; count++) {
+      // Set up address lines
+      PORTH = (PORTH & 0xFC) | ((address & 0x0001)<<1) | ((address & 0x0002)>>1); // A0-A1
+      PORTD = (PORTD & 0xF0) | ((address & 0x0004)<<1) | ((address & 0x0008)>>1) | ((address & 0x0010)>>3) | ((address & 0x0020)>>5); // A2-A5
+      PORTA = ((address & 0x3FC0)>>6); // A6-A13
+      PORTC = (PORTC & 0x3F) | ((address & 0x4000)>>7) | ((address & 0x8000)>>9); // A14-A15
+
+      // Wait for a falling edge of the clock
+      while((PINE & 0x20));
+
+      // Set VMA ON
+      PORTG = PORTG | 0x20;
+
+      // Wait a full clock cycle to make sure data lines are ready
+      while(!(PINE & 0x20));
+      while((PINE & 0x20));
+      while(!(PINE & 0x20));
+
+      byte inputData;
+      inputData = (PINH & 0x78)>>3;
+      inputData |= (PINB & 0x70);
+      inputData |= PINJ << 7;
+      *buffer++ = inputData;
+
+      // Set VMA OFF
+      PORTG = PORTG & 0xDF;
+      address += 1;
+    }
+
+    // Set R/W to LOW
+    PORTE = (PORTE & 0xF7);
+
+    // Unset address lines
+    PORTH = (PORTH & 0xFC);
+    PORTD = (PORTD & 0xF0);
+    PORTA = 0;
+    PORTC = (PORTC & 0x3F);
+
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+
+// Writes value to numBytes consecutive addresses (the first element of a
+// RAM march), with interrupts held off one chunk at a time
+void RPU_DataFillBlock(int address, byte value, int numBytes) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+
+    // Set data pins to output
+    DDRH = DDRH | 0x78;
+    DDRB = DDRB | 0x70;
+    DDRJ = DDRJ | 0x01;
+
+    // Set R/W to LOW
+    PORTE = (PORTE & 0xF7);
+
+    // Put data on pins
+    PORTH = (PORTH&0x87) | ((value&0x0F)<<3);
+    PORTB = (PORTB&0x8F) | ((value&0x70));
+    PORTJ = (PORTJ&0xFE) | (value>>7);  
+
+    for (byte count=0; count<chunkSize; count++) {
+      // Set up address lines
+      PORTH = (PORTH & 0xFC) | ((address & 0x0001)<<1) | ((address & 0x0002)>>1); // A0-A1
+      PORTD = (PORTD & 0xF0) | ((address & 0x0004)<<1) | ((address & 0x0008)>>1) | ((address & 0x0010)>>3) | ((address & 0x0020)>>5); // A2-A5
+      PORTA = ((address & 0x3FC0)>>6); // A6-A13
+      PORTC = (PORTC & 0x3F) | ((address & 0x4000)>>7) | ((address & 0x8000)>>9); // A14-A15
+
+      // Wait for a falling edge of the clock
+      while((PINE & 0x20));
+
+      // Pulse VMA over one clock cycle
+      PORTG = PORTG | 0x20;
+      while(!(PINE & 0x20));
+      while((PINE & 0x20));
+      while(!(PINE & 0x20));
+      PORTG = PORTG & 0xDF;
+      address += 1;
+    }
+
+    // Unset address lines
+    PORTH = (PORTH & 0xFC);
+    PORTD = (PORTD & 0xF0);
+    PORTA = 0;
+    PORTC = (PORTC & 0x3F);
+  
+    // Set R/W back to HIGH
+    PORTE = (PORTE | 0x08);
+
+    // Set data pins to input
+    DDRH = DDRH & 0x87;
+    DDRB = DDRB & 0x8F;
+    DDRJ = DDRJ & 0xFE;
+
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+
+// One element of a RAM march: at each of numBytes addresses (counting down
+// from address if descending) the cell is read into readBuffer and then
+// writeValue is written to it. The address lines are set once for both
+// cycles, and interrupts are held off one chunk at a time.
+void RPU_DataReadWriteBlock(int address, byte *readBuffer, byte writeValue, int numBytes, boolean descending) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+
+    DDRE = DDRE | 0x08;
+
+    for (byte count=0; count<chunkSize; count++) {
+      // Set up address lines
+      PORTH = (PORTH & 0xFC) | ((address & 0x0001)<<1) | ((address & 0x0002)>>1); // A0-A1
+      PORTD = (PORTD & 0xF0) | ((address & 0x0004)<<1) | ((address & 0x0008)>>1) | ((address & 0x0010)>>3) | ((address & 0x0020)>>5); // A2-A5
+      PORTA = ((address & 0x3FC0)>>6); // A6-A13
+      PORTC = (PORTC & 0x3F) | ((address & 0x4000)>>7) | ((address & 0x8000)>>9); // A14-A15
+
+      // Read: data pins to input, R/W HIGH
+      DDRH = DDRH & 0x87;
+      DDRB = DDRB & 0x8F;
+      DDRJ = DDRJ & 0xFE;
+      PORTE = (PORTE | 0x08);
+
+      while((PINE & 0x20));
+      PORTG = PORTG | 0x20;
+      while(!(PINE & 0x20));
+      while((PINE & 0x20));
+      while(!(PINE & 0x20));
+
+      byte inputData;
+      inputData = (PINH & 0x78)>>3;
+      inputData |= (PINB & 0x70);
+      inputData |= PINJ << 7;
+      *readBuffer++ = inputData;
+      PORTG = PORTG & 0xDF;
+
+      // Write: R/W LOW, data pins to output
+      PORTE = (PORTE & 0xF7);
+      DDRH = DDRH | 0x78;
+      DDRB = DDRB | 0x70;
+      DDRJ = DDRJ | 0x01;
+      PORTH = (PORTH&0x87) | ((writeValue&0x0F)<<3);
+      PORTB = (PORTB&0x8F) | ((writeValue&0x70));
+      PORTJ = (PORTJ&0xFE) | (writeValue>>7);  
+
+      while((PINE & 0x20));
+      PORTG = PORTG | 0x20;
+      while(!(PINE & 0x20));
+      while((PINE & 0x20));
+      while(!(PINE & 0x20));
+      PORTG = PORTG & 0xDF;
+
+      address += descending ? -1 : 1;
+    }
+
+    // Unset address lines
+    PORTH = (PORTH & 0xFC);
+    PORTD = (PORTD & 0xF0);
+    PORTA = 0;
+    PORTC = (PORTC & 0x3F);
+
+    // Set R/W back to HIGH
+    PORTE = (PORTE | 0x08);
+
+    // Set data pins to input
+    DDRH = DDRH & 0x87;
+    DDRB = DDRB & 0x8F;
+    DDRJ = DDRJ & 0xFE;
+
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+
 #elif (RPU_OS_HARDWARE_REV==4)
 
 // Rev 3 connections
@@ -1073,6 +1391,52 @@ byte RPU_DataRead(int address) {
 #error "RPU Hardware Definition Not Recognized"
 #endif
 
+#ifndef RPU_OS_HAS_DATA_READ_BLOCK
+// Like the rev 3 version, interrupts are held off one chunk at a time so 
+// their bus cycles can't land in the middle of one of these reads
+#define RPU_DATA_READ_BLOCK_CHUNK   16
+void RPU_DataReadBlock(int address, byte *buffer, int numBytes) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+    for (byte count=0; count<chunkSize; count++) {
+      *buffer++ = RPU_DataRead(address++);
+    }
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+
+void RPU_DataFillBlock(int address, byte value, int numBytes) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+    for (byte count=0; count<chunkSize; count++) {
+      RPU_DataWrite(address++, value);
+    }
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+
+void RPU_DataReadWriteBlock(int address, byte *readBuffer, byte writeValue, int numBytes, boolean descending) {
+  while (numBytes>0) {
+    byte chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    byte oldSREG = SREG;
+    cli();
+    for (byte count=0; count<chunkSize; count++) {
+      *readBuffer++ = RPU_DataRead(address);
+      RPU_DataWrite(address, writeValue);
+      address += descending ? -1 : 1;
+    }
+    SREG = oldSREG;
+    numBytes -= chunkSize;
+  }
+}
+#endif
+
 
 #if (RPU_MPU_ARCHITECTURE<10)
 
@@ -1374,24 +1738,315 @@ void RPU_PushToSwitchStack(byte switchNumber) {
 }
 
 
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+/******************************************************
+ *   Switch Recording
+ */
+// Closures pulled from the switch stack, closures and openings seen in the
+// switch matrix and markers (the machine state) go into a ring with the
+// time since the event before. The ring can be dumped to Serial, or replayed through
+// RPU_PullFirstFromSwitchStack and RPU_ReadSingleSwitchState with the
+// recorded timing.
+#ifndef RPU_OS_SWITCH_EVENT_LOG_SIZE
+#define RPU_OS_SWITCH_EVENT_LOG_SIZE  64
+#endif
+struct SwitchEvent {
+  unsigned int timeDelta; // ms since the event before (tops out at 65535)
+  byte switchNum;         // or the marker
+  byte edge;
+};
+SwitchEvent SwitchEventLog[RPU_OS_SWITCH_EVENT_LOG_SIZE];
+byte SwitchEventLogFirst = 0;
+byte SwitchEventLogCount = 0;
+unsigned long SwitchEventLastTime = 0;
+byte SwitchEventClosed[RPU_SWITCH_MATRIX_BYTES];
+
+boolean SwitchReplayActive = false;
+byte SwitchReplayIndex = 0;
+byte SwitchReplayEnd = 0;
+unsigned long SwitchReplayNextTime = 0;
+byte SwitchReplayClosed[RPU_SWITCH_MATRIX_BYTES];
+
+SwitchEvent *GetSwitchEvent(byte eventNum) {
+  byte index = SwitchEventLogFirst + eventNum;
+  if (index>=RPU_OS_SWITCH_EVENT_LOG_SIZE) index -= RPU_OS_SWITCH_EVENT_LOG_SIZE;
+  return &SwitchEventLog[index];
+}
+
+void RecordSwitchEvent(byte switchNum, byte edge) {
+  unsigned long currentTime = millis();
+  unsigned long timeDelta = currentTime - SwitchEventLastTime;
+  SwitchEventLastTime = currentTime;
+
+  // When the ring is full, the oldest event is dropped
+  SwitchEvent *newEvent;
+  if (SwitchEventLogCount<RPU_OS_SWITCH_EVENT_LOG_SIZE) {
+    SwitchEventLogCount += 1;
+    newEvent = GetSwitchEvent(SwitchEventLogCount-1);
+  } else {
+    newEvent = GetSwitchEvent(0);
+    SwitchEventLogFirst += 1;
+    if (SwitchEventLogFirst>=RPU_OS_SWITCH_EVENT_LOG_SIZE) SwitchEventLogFirst = 0;
+  }
+  newEvent->timeDelta = (timeDelta>0xFFFF) ? 0xFFFF : timeDelta;
+  newEvent->switchNum = switchNum;
+  newEvent->edge = edge;
+}
+
+// Called from RPU_PullFirstFromSwitchStack with the switch it pulled.
+// The matrix is SwitchesNow, which RPU_ReadSingleSwitchState reads, so its
+// changes are timed from when the app could first see them (a closure
+// reaches the stack a debounce later, and the last complete scan can be a
+// scan behind).
+void RecordSwitchEvents(byte pulledSwitch) {
+  byte switchBytes[NUM_SWITCH_BYTES];
+  byte oldSREG = SREG;
+  cli();
+  for (byte switchByte=0; switchByte<NUM_SWITCH_BYTES; switchByte++) switchBytes[switchByte] = SwitchesNow[switchByte];
+  SREG = oldSREG;
+
+  for (byte switchByte=0; switchByte<NUM_SWITCH_BYTES; switchByte++) {
+    byte changed = SwitchEventClosed[switchByte] ^ switchBytes[switchByte];
+    SwitchEventClosed[switchByte] = switchBytes[switchByte];
+    for (byte switchBit=0; changed; switchBit++, changed>>=1) {
+      if (!(changed & 0x01)) continue;
+      RecordSwitchEvent(switchByte*8 + switchBit, (switchBytes[switchByte] & (0x01<<switchBit)) ? RPU_SWITCH_EVENT_SEEN_CLOSED : RPU_SWITCH_EVENT_OPENED);
+    }
+  }
+
+  if (pulledSwitch!=SWITCH_STACK_EMPTY) RecordSwitchEvent(pulledSwitch, RPU_SWITCH_EVENT_CLOSED);
+}
+
+void StopSwitchReplay() {
+  SwitchReplayActive = false;
+  // Switches held now are recorded as closing when the next switch is pulled
+  for (byte switchByte=0; switchByte<RPU_SWITCH_MATRIX_BYTES; switchByte++) SwitchEventClosed[switchByte] = 0x00;
+  SwitchEventLastTime = millis();
+}
+
+// Returns the next replayed closure once its time has come
+byte PullFromSwitchReplay() {
+  unsigned long currentTime = millis();
+  while (SwitchReplayIndex<SwitchReplayEnd) {
+    if ((long)(currentTime - SwitchReplayNextTime) < 0) return SWITCH_STACK_EMPTY;
+
+    SwitchEvent *replayEvent = GetSwitchEvent(SwitchReplayIndex);
+    SwitchReplayIndex += 1;
+    if (SwitchReplayIndex<SwitchReplayEnd) SwitchReplayNextTime += GetSwitchEvent(SwitchReplayIndex)->timeDelta;
+
+    byte switchNum = replayEvent->switchNum;
+    if (replayEvent->edge==RPU_SWITCH_EVENT_MARKER) continue;
+    if (switchNum<MAX_NUM_SWITCHES) {
+      if (replayEvent->edge==RPU_SWITCH_EVENT_OPENED) SwitchReplayClosed[switchNum/8] &= ~(0x01<<(switchNum%8));
+      else SwitchReplayClosed[switchNum/8] |= (0x01<<(switchNum%8));
+    }
+    if (replayEvent->edge==RPU_SWITCH_EVENT_CLOSED) return switchNum;
+  }
+
+  StopSwitchReplay();
+  return SWITCH_STACK_EMPTY;
+}
+
+void RPU_RecordSwitchMarker(byte marker) {
+  if (!SwitchReplayActive) RecordSwitchEvent(marker, RPU_SWITCH_EVENT_MARKER);
+}
+
+byte RPU_GetSwitchEventCount() {
+  return SwitchEventLogCount;
+}
+
+void RPU_ClearSwitchEvents() {
+  SwitchReplayActive = false;
+  SwitchEventLogFirst = 0;
+  SwitchEventLogCount = 0;
+  SwitchEventLastTime = millis();
+}
+
+boolean RPU_GetSwitchEvent(byte eventNum, unsigned int *timeDelta, byte *switchNum, byte *edge) {
+  if (eventNum>=SwitchEventLogCount) return false;
+  SwitchEvent *logEvent = GetSwitchEvent(eventNum);
+  *timeDelta = logEvent->timeDelta;
+  *switchNum = logEvent->switchNum;
+  *edge = logEvent->edge;
+  return true;
+}
+
+// Writes the events as "ms,switch,edge" lines (C = closed, O = opened, 
+// M = marker, S = seen closed) with times from the first event
+const char SwitchEventEdgeNames[4] PROGMEM = {'C', 'O', 'M', 'S'};
+void RPU_DumpSwitchEvents() {
+  char buf[32];
+  unsigned long eventTime = 0;
+  // The WAV Trigger has already started Serial on rev 3 and earlier boards
+  // (it ignores text - its messages start with 0xF0)
+#if !((defined(RPU_OS_USE_WAV_TRIGGER) || defined(RPU_OS_USE_WAV_TRIGGER_1p3)) && (RPU_OS_HARDWARE_REV<=3))
+  Serial.begin(57600);
+#endif
+  Serial.write("* Switch events\n");
+  for (byte eventNum=0; eventNum<SwitchEventLogCount; eventNum++) {
+    SwitchEvent *logEvent = GetSwitchEvent(eventNum);
+    if (eventNum) eventTime += logEvent->timeDelta;
+    sprintf(buf, "%lu,%d,%c\n", eventTime, logEvent->switchNum, pgm_read_byte(&SwitchEventEdgeNames[logEvent->edge&0x03]));
+    Serial.write(buf);
+  }
+}
+
+// Replays from the oldest marker up to the newest one (so what was done
+// after the newest marker - asking for the replay - isn't replayed).
+// Returns the oldest marker, or RPU_SWITCH_REPLAY_NO_MARKER.
+byte RPU_StartSwitchReplay() {
+  byte startMarker = RPU_SWITCH_REPLAY_NO_MARKER;
+  SwitchReplayIndex = 0;
+  SwitchReplayEnd = SwitchEventLogCount;
+  for (byte eventNum=0; eventNum<SwitchEventLogCount; eventNum++) {
+    SwitchEvent *logEvent = GetSwitchEvent(eventNum);
+    if (logEvent->edge!=RPU_SWITCH_EVENT_MARKER) continue;
+    if (startMarker==RPU_SWITCH_REPLAY_NO_MARKER) {
+      startMarker = logEvent->switchNum;
+      SwitchReplayIndex = eventNum + 1;
+    } else {
+      SwitchReplayEnd = eventNum;
+    }
+  }
+  if (SwitchReplayIndex>=SwitchReplayEnd) return RPU_SWITCH_REPLAY_NO_MARKER;
+
+  for (byte switchByte=0; switchByte<RPU_SWITCH_MATRIX_BYTES; switchByte++) SwitchReplayClosed[switchByte] = 0x00;
+  SwitchReplayNextTime = millis() + GetSwitchEvent(SwitchReplayIndex)->timeDelta;
+  SwitchReplayActive = true;
+  return startMarker;
+}
+
+boolean RPU_IsSwitchReplayActive() {
+  return SwitchReplayActive;
+}
+
+byte RPU_GetSwitchReplayEventsLeft() {
+  if (!SwitchReplayActive) return 0;
+  return SwitchReplayEnd - SwitchReplayIndex;
+}
+#endif
+
+
 byte RPU_PullFirstFromSwitchStack() {
+  byte retVal = SWITCH_STACK_EMPTY;
+
   // If first and last are equal, there's nothing on the stack
-  if (SwitchStackFirst==SwitchStackLast) return SWITCH_STACK_EMPTY;
+  if (SwitchStackFirst!=SwitchStackLast) {
+    retVal = SwitchStack[SwitchStackFirst];
 
-  byte retVal = SwitchStack[SwitchStackFirst];
+    SwitchStackFirst += 1;
+    if (SwitchStackFirst>=SWITCH_STACK_SIZE) SwitchStackFirst = 0;
+  }
 
-  SwitchStackFirst += 1;
-  if (SwitchStackFirst>=SWITCH_STACK_SIZE) SwitchStackFirst = 0;
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+  if (SwitchReplayActive) {
+    // A real switch takes over from the replay
+    if (retVal==SWITCH_STACK_EMPTY) return PullFromSwitchReplay();
+    StopSwitchReplay();
+  }
+  RecordSwitchEvents(retVal);
+#endif
 
   return retVal;
 }
 
 
+void RPU_SetSwitchDebounce(byte switchNum, byte numSamples) {
+  if (switchNum>=MAX_NUM_SWITCHES) return;
+  if (numSamples<1) numSamples = 1;
+  if (numSamples>SWITCH_DEBOUNCE_MAX_SAMPLES) numSamples = SWITCH_DEBOUNCE_MAX_SAMPLES;
+
+  byte switchByte = switchNum/8;
+  byte switchBit = 0x01<<(switchNum%8);
+  for (byte plane=0; plane<RPU_OS_SWITCH_DEBOUNCE_PLANES; plane++) {
+    if (numSamples & (0x01<<plane)) SwitchDebounceLength[plane][switchByte] |= switchBit;
+    else SwitchDebounceLength[plane][switchByte] &= ~switchBit;
+  }
+}
+
+
+void RPU_SetAllSwitchDebounce(byte numSamples) {
+  for (byte switchNum=0; switchNum<MAX_NUM_SWITCHES; switchNum++) RPU_SetSwitchDebounce(switchNum, numSamples);
+}
+
+
+// Counts the latest sample (SwitchesNow) into the vertical counter for one
+// switch byte. Returns the switches whose count just reached their debounce
+// length, and puts the switches that just closed (off, on) in startingClosures.
+byte DebounceSwitchByte(byte switchByte, byte *startingClosures) {
+  byte closed = SwitchesNow[switchByte];
+  byte plane;
+
+  // Counts stop at the max so a held switch doesn't wrap around
+  byte saturated = 0xFF;
+  for (plane=0; plane<RPU_OS_SWITCH_DEBOUNCE_PLANES; plane++) saturated &= SwitchClosedCount[plane][switchByte];
+
+  byte carry = closed & ~saturated;
+  byte reachedLength = ~saturated;
+  byte firstSample = ~saturated;
+  for (plane=0; plane<RPU_OS_SWITCH_DEBOUNCE_PLANES; plane++) {
+    byte countBit = SwitchClosedCount[plane][switchByte];
+    // An open switch starts counting again from zero
+    byte newCountBit = (countBit ^ carry) & closed;
+    carry &= countBit;
+    SwitchClosedCount[plane][switchByte] = newCountBit;
+    reachedLength &= ~(newCountBit ^ SwitchDebounceLength[plane][switchByte]);
+    if (plane==0) firstSample &= newCountBit;
+    else firstSample &= ~newCountBit;
+  }
+
+  if (startingClosures) *startingClosures = firstSample & ~reachedLength;
+  return reachedLength;
+}
+
+
+// Called by the interrupt when every column has been read
+void PublishSwitchMatrix() {
+  for (byte switchByte=0; switchByte<NUM_SWITCH_BYTES; switchByte++) SwitchesLastScan[switchByte] = SwitchesNow[switchByte];
+}
+
+
+// Copies the closed switches from the last complete scan, one bit per 
+// switch, into RPU_SWITCH_MATRIX_BYTES bytes. Interrupts are held off
+// only for the copy, so it can't be torn by a scan finishing.
+void RPU_GetSwitchMatrixSnapshot(byte *switchBytes) {
+  byte switchByte;
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+  if (SwitchReplayActive) {
+    for (switchByte=0; switchByte<RPU_SWITCH_MATRIX_BYTES; switchByte++) switchBytes[switchByte] = SwitchReplayClosed[switchByte];
+    return;
+  }
+#endif
+  byte oldSREG = SREG;
+  cli();
+  for (switchByte=0; switchByte<NUM_SWITCH_BYTES; switchByte++) switchBytes[switchByte] = SwitchesLastScan[switchByte];
+  SREG = oldSREG;
+  for (; switchByte<RPU_SWITCH_MATRIX_BYTES; switchByte++) switchBytes[switchByte] = 0x00;
+}
+
+
+byte RPU_PopCount(byte value) {
+  value = value - ((value>>1) & 0x55);
+  value = (value & 0x33) + ((value>>2) & 0x33);
+  return (value + (value>>4)) & 0x0F;
+}
+
+
+byte RPU_PopCountBytes(byte *values, byte numBytes) {
+  byte count = 0;
+  for (byte valueCount=0; valueCount<numBytes; valueCount++) count += RPU_PopCount(values[valueCount]);
+  return count;
+}
+
+
 boolean RPU_ReadSingleSwitchState(byte switchNum) {
   if (switchNum>=MAX_NUM_SWITCHES) return false;
 
   int switchByte = switchNum/8;
   int switchBit = switchNum%8;
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+  if (SwitchReplayActive) return ((SwitchReplayClosed[switchByte])>>switchBit) & 0x01;
+#endif
   if ( ((SwitchesNow[switchByte])>>switchBit) & 0x01 ) return true;
   else return false;
 }
@@ -1445,54 +2100,135 @@ int SpaceLeftOnSolenoidStack() {
 }
 
 
-void RPU_PushToSolenoidStack(byte solenoidNumber, byte numPushes, boolean disableOverride, byte relay) {
-  if (solenoidNumber >= RPU_NUM_SOLENOIDS && relay == 99) return;
-  if (solenoidNumber >= 2 * RPU_NUM_SOLENOIDS) return;
+void RPU_SetSolenoidRelay(byte relayLamp, byte settleTicks) {
+  if (relayLamp>=RPU_MAX_LAMPS) relayLamp = SOLENOID_RELAY_NONE;
 
-  if (solenoidNumber >= RPU_NUM_SOLENOIDS) {
-    RPU_SetLampState(relay, 1, 0, 0);
-    solenoidNumber = solenoidNumber - RPU_NUM_SOLENOIDS;
+  noInterrupts();
+  SolenoidRelayLamp = relayLamp;
+  SolenoidRelaySettleTicks = settleTicks;
+  SolenoidRelaySettleCountdown = 0;
+  if (relayLamp!=SOLENOID_RELAY_NONE) {
+    SolenoidRelayBank = relayLamp/8;
+    SolenoidRelayBit = 0x01<<(relayLamp%8);
+    // Lamp states are active low
+    SolenoidRelaySideC = (LampStateBuffers[LampFrontBuffer][SolenoidRelayBank]&SolenoidRelayBit) ? false : true;
   }
-  else
-    RPU_SetLampState(relay, 0, 0, 0);
+  interrupts();
+}
+
+unsigned long RPU_GetSolenoidRelayFlips() {
+  noInterrupts();
+  unsigned long numFlips = SolenoidRelayFlips;
+  interrupts();
+  return numFlips;
+}
+
+// Solenoids past RPU_NUM_SOLENOIDS are on the relay side
+byte SolenoidStackEntryNumber(byte solenoidNumber) {
+  if (solenoidNumber < RPU_NUM_SOLENOIDS) return solenoidNumber;
+  if (SolenoidRelayLamp==SOLENOID_RELAY_NONE || solenoidNumber >= 2 * RPU_NUM_SOLENOIDS) return SOLENOID_STACK_EMPTY;
+  return (solenoidNumber - RPU_NUM_SOLENOIDS) | SOLENOID_RELAY_SIDE_C;
+}
+
+void RPU_PushToSolenoidStack(byte solenoidNumber, byte numPushes, boolean disableOverride, byte relay) {
+  // A relay passed in here becomes the relay for all pushes
+  if (relay!=SOLENOID_RELAY_NONE && relay!=SolenoidRelayLamp) RPU_SetSolenoidRelay(relay, SolenoidRelaySettleTicks);
+
+  solenoidNumber = SolenoidStackEntryNumber(solenoidNumber);
+  if (solenoidNumber==SOLENOID_STACK_EMPTY) return;
 
   // if the solenoid stack is disabled and this isn't an override push, then return
   if (!disableOverride && !SolenoidStackEnabled) return;
 
-  // If the solenoid stack last index is out of range, then it's an error - return
-  if (SpaceLeftOnSolenoidStack()==0) return;
+  // If the solenoid stack is full (or the last index is out of range), return
+  if (SpaceLeftOnSolenoidStack()==0 || numPushes==0) return;
 
-  for (int count=0; count<numPushes; count++) {
-    SolenoidStack[SolenoidStackLast] = solenoidNumber;
-    
+  // Fill in the entry before moving the index, because the interrupt may be reading the stack
+  SolenoidStack[SolenoidStackLast].solenoidNumber = solenoidNumber;
+  SolenoidStack[SolenoidStackLast].numTicks = numPushes;
+
+  if ((SolenoidStackLast+1)==SOLENOID_STACK_SIZE) {
+    // If the end index is off the end, then wrap
+    SolenoidStackLast = 0;
+  } else {
     SolenoidStackLast += 1;
-    if (SolenoidStackLast==SOLENOID_STACK_SIZE) {
-      // If the end index is off the end, then wrap
-      SolenoidStackLast = 0;
-    }
-    // If the stack is now full, return
-    if (SpaceLeftOnSolenoidStack()==0) return;
   }
 }
 
 void PushToFrontOfSolenoidStack(byte solenoidNumber, byte numPushes) {
   // If the stack is full, return
-  if (SpaceLeftOnSolenoidStack()==0  || !SolenoidStackEnabled) return;
+  if (SpaceLeftOnSolenoidStack()==0  || !SolenoidStackEnabled || numPushes==0) return;
 
-  for (int count=0; count<numPushes; count++) {
-    if (SolenoidStackFirst==0) SolenoidStackFirst = SOLENOID_STACK_SIZE-1;
-    else SolenoidStackFirst -= 1;
-    SolenoidStack[SolenoidStackFirst] = solenoidNumber;
-    if (SpaceLeftOnSolenoidStack()==0) return;
+  solenoidNumber = SolenoidStackEntryNumber(solenoidNumber);
+  if (solenoidNumber==SOLENOID_STACK_EMPTY) return;
+
+  byte newFirst = (SolenoidStackFirst==0) ? (SOLENOID_STACK_SIZE-1) : (SolenoidStackFirst-1);
+  SolenoidStack[newFirst].solenoidNumber = solenoidNumber;
+  SolenoidStack[newFirst].numTicks = numPushes;
+  SolenoidStackFirst = newFirst;
+}
+
+boolean SolenoidEntryOnRelaySide(byte stackIndex) {
+  return ((SolenoidStack[stackIndex].solenoidNumber & SOLENOID_RELAY_SIDE_C) ? true : false)==SolenoidRelaySideC;
+}
+
+// Swaps the next entry for the side the relay is on to the front of the stack
+boolean PullRelaySideForward() {
+  byte stackIndex = SolenoidStackFirst;
+  while (1) {
+    stackIndex += 1;
+    if (stackIndex>=SOLENOID_STACK_SIZE) stackIndex = 0;
+    if (stackIndex==SolenoidStackLast) return false;
+    if (SolenoidEntryOnRelaySide(stackIndex)) {
+      byte solenoidNumber = SolenoidStack[stackIndex].solenoidNumber;
+      byte numTicks = SolenoidStack[stackIndex].numTicks;
+      SolenoidStack[stackIndex].solenoidNumber = SolenoidStack[SolenoidStackFirst].solenoidNumber;
+      SolenoidStack[stackIndex].numTicks = SolenoidStack[SolenoidStackFirst].numTicks;
+      SolenoidStack[SolenoidStackFirst].solenoidNumber = solenoidNumber;
+      SolenoidStack[SolenoidStackFirst].numTicks = numTicks;
+      return true;
+    }
   }
-  
 }
 
 byte PullFirstFromSolenoidStack() {
+  if (SolenoidRelayLamp!=SOLENOID_RELAY_NONE) {
+    // If something else switched the relay lamp, the relay has to settle again
+    boolean relayLampOn = (LampStateBuffers[LampFrontBuffer][SolenoidRelayBank]&SolenoidRelayBit) ? false : true;
+    if (relayLampOn!=SolenoidRelaySideC) {
+      SolenoidRelaySideC = relayLampOn;
+      SolenoidRelaySettleCountdown = SolenoidRelaySettleTicks;
+      SolenoidRelayFlips += 1;
+    }
+    if (SolenoidRelaySettleCountdown) {
+      SolenoidRelaySettleCountdown -= 1;
+      return SOLENOID_STACK_EMPTY;
+    }
+  }
+
   // If first and last are equal, there's nothing on the stack
   if (SolenoidStackFirst==SolenoidStackLast) return SOLENOID_STACK_EMPTY;
+
+  if (SolenoidRelayLamp!=SOLENOID_RELAY_NONE && !SolenoidEntryOnRelaySide(SolenoidStackFirst) && !PullRelaySideForward()) {
+    // Nothing left for this side, so switch the relay and let it settle
+    SolenoidRelaySideC = !SolenoidRelaySideC;
+    // Both lamp buffers, so a frame being composed doesn't switch it back
+    for (byte buffer=0; buffer<2; buffer++) {
+      if (SolenoidRelaySideC) LampStateBuffers[buffer][SolenoidRelayBank] &= ~SolenoidRelayBit;
+      else LampStateBuffers[buffer][SolenoidRelayBank] |= SolenoidRelayBit;
+    }
+    SolenoidRelaySettleCountdown = SolenoidRelaySettleTicks;
+    SolenoidRelayFlips += 1;
+    return SOLENOID_STACK_EMPTY;
+  }
   
-  byte retVal = SolenoidStack[SolenoidStackFirst];
+  byte retVal = SolenoidStack[SolenoidStackFirst].solenoidNumber & ~SOLENOID_RELAY_SIDE_C;
+
+  // The entry stays on the stack until its ticks run out
+  if (SolenoidStack[SolenoidStackFirst].numTicks>1) {
+    SolenoidStack[SolenoidStackFirst].numTicks -= 1;
+    return retVal;
+  }
 
   SolenoidStackFirst += 1;
   if (SolenoidStackFirst>=SOLENOID_STACK_SIZE) SolenoidStackFirst = 0;
@@ -1525,34 +2261,55 @@ void RPU_UpdateTimedSolenoidStack(unsigned long curTime, byte relay) {
 
 #if (RPU_MPU_ARCHITECTURE<10)
 
-void RPU_SetCoinLockout(boolean lockoutOff, byte solbit) {
-  if (!lockoutOff) {
-    CurrentSolenoidByte = CurrentSolenoidByte & ~solbit;
-  } else {
-    CurrentSolenoidByte = CurrentSolenoidByte | solbit;
+// Loop code that writes U10:A or U11:B calls this instead of cli(). The
+// zero-crossing work is spread over Timer2 steps with the loop running in
+// between (a switch column stays strobed on U10:A while it settles), so 
+// this waits for a sequence in flight to finish. It returns with interrupts 
+// off, so a new one can't start until SREG is put back. When interrupts 
+// are already off (an interrupt handler, or the sequence itself) it can't
+// wait and just returns.
+byte LockBusBetweenStrobes() {
+  byte oldSREG = SREG;
+  cli();
+  if (!(oldSREG & 0x80)) return oldSREG;
+  while (InsideZeroCrossingInterrupt) {
+    SREG = oldSREG;
+    // Let Timer2 get to the next step
+    delayMicroseconds(4);
+    cli();
   }
-  RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  return oldSREG;
 }
 
 
-void RPU_SetDisableFlippers(boolean disableFlippers, byte solbit) {
-  if (disableFlippers) {
-    CurrentSolenoidByte = CurrentSolenoidByte | solbit;
+// Changes continuous solenoid bits from the loop. Interrupts are held off
+// so the zero-crossing handler can't change CurrentSolenoidByte between the
+// read and the write, and while a sound byte is on U11B the write is left 
+// for the sound restore.
+void SetSolenoidByteBits(boolean bitsOn, byte solbits) {
+  byte oldSREG = LockBusBetweenStrobes();
+  if (bitsOn) {
+    CurrentSolenoidByte = CurrentSolenoidByte | solbits;
   } else {
-    CurrentSolenoidByte = CurrentSolenoidByte & ~solbit;
+    CurrentSolenoidByte = CurrentSolenoidByte & ~solbits;
   }
-  
-  RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  if (!SoundTransferActive) RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  SREG = oldSREG;
+}
+
+
+void RPU_SetCoinLockout(boolean lockoutOff, byte solbit) {
+  SetSolenoidByteBits(lockoutOff, solbit);
+}
+
+
+void RPU_SetDisableFlippers(boolean disableFlippers, byte solbit) {
+  SetSolenoidByteBits(disableFlippers, solbit);
 }
 
 
 void RPU_SetContinuousSolenoidBit(boolean bitOn, byte solbit) {
-  if (bitOn) {
-    CurrentSolenoidByte = CurrentSolenoidByte | solbit;
-  } else {
-    CurrentSolenoidByte = CurrentSolenoidByte & ~solbit;
-  }
-  RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  SetSolenoidByteBits(bitOn, solbit);
 }
 
 
@@ -1634,7 +2391,64 @@ void RPU_EnableSolenoidStack() {
  *   Display Handling Functions
  */
 #if (RPU_MPU_ARCHITECTURE<15)
-byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude) {
+// The value last converted for each display. Most callers set the same
+// value every loop, so an unchanged value skips the conversion.
+#define DISPLAY_CACHE_INVALID   0xFF
+unsigned long DisplayValueCache[5];
+byte DisplayMinDigitsCache[5] = {DISPLAY_CACHE_INVALID, DISPLAY_CACHE_INVALID, DISPLAY_CACHE_INVALID, DISPLAY_CACHE_INVALID, DISPLAY_CACHE_INVALID};
+byte DisplayBlankCache[5];
+
+void InvalidateDisplayCache(int displayNumber) {
+  DisplayMinDigitsCache[displayNumber] = DISPLAY_CACHE_INVALID;
+}
+
+// Stops some digits blinking without changing the rest of the animation
+void StopDisplayBlinkDigits(int displayNumber, byte digitMask) {
+  noInterrupts();
+  DisplayAnimations[displayNumber].blinkMask &= ~digitMask;
+  DisplayAnimations[displayNumber].blinkGate |= digitMask;
+  interrupts();
+}
+
+// Converts value to ten packed BCD digits (packedBCD[0] holds the two
+// least-significant digits) using shift-and-add-3 (double dabble).
+// The AVR has no divide instruction, so this is much cheaper 
+// than a %10 and a /10 for every digit.
+void ConvertToPackedBCD(unsigned long value, byte *packedBCD) {
+  byte count;
+  for (count=0; count<5; count++) packedBCD[count] = 0;
+
+  // Leading zero bytes don't need to be shifted through
+  byte numBits = 32;
+  while (numBits && (value&0xFF000000)==0) {
+    value = value<<8;
+    numBits -= 8;
+  }
+
+  // Only the digit pairs reached so far are worked on (the top one is
+  // kept at zero, so nothing carries out of it)
+  byte numPairs = 1;
+  for (; numBits; numBits--) {
+    // Any digit of 5 or more gets 3 added so the shift carries into the next digit
+    for (count=0; count<numPairs; count++) {
+      byte digitPair = packedBCD[count];
+      if ((digitPair&0x0F)>=0x05) digitPair += 0x03;
+      if ((digitPair&0xF0)>=0x50) digitPair += 0x30;
+      packedBCD[count] = digitPair;
+    }
+    // Shift the top bit of the value into the digits
+    byte carry = (value&0x80000000) ? 1 : 0;
+    value = value<<1;
+    for (count=0; count<numPairs; count++) {
+      byte nextCarry = packedBCD[count]>>7;
+      packedBCD[count] = (packedBCD[count]<<1) | carry;
+      carry = nextCarry;
+    }
+    if (packedBCD[numPairs-1] && numPairs<5) numPairs += 1;
+  }
+}
+
+byte SetDisplayDigits(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude) {
   if (displayNumber<0 || displayNumber>4) return 0;
 
   byte blank = 0x00;
@@ -1642,28 +2456,39 @@ byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagni
   byte commaBit = 0x01 << (2*displayNumber);
   if (!showCommasByMagnitude) {
     DisplayCommas &= ~(commaBit | (commaBit*2));
+  } else {
+    if (value>=1000) DisplayCommas |= commaBit;
+    else DisplayCommas &= ~(commaBit);
+    if (value>=1000000) DisplayCommas |= (commaBit*2);
+    else DisplayCommas &= ~(commaBit*2);
   }
+#else
+  (void)showCommasByMagnitude;
 #endif
 
-  for (int count=0; count<RPU_OS_NUM_DIGITS; count++) {
-    blank = blank * 2;
-    if (value!=0 || count<minDigits) blank |= 1;
+  if (DisplayMinDigitsCache[displayNumber]==minDigits && DisplayValueCache[displayNumber]==value) {
+    // Digits are already up to date
+    blank = DisplayBlankCache[displayNumber];
+  } else {
+    byte packedBCD[5];
+    ConvertToPackedBCD(value, packedBCD);
 
-#if (RPU_MPU_ARCHITECTURE>=13)    
-    if (showCommasByMagnitude) {
-      if (value) {
-        if (count==3) DisplayCommas |= commaBit;
-        if (count==6) DisplayCommas |= (commaBit*2);
-      } else {
-        if (count==3) DisplayCommas &= ~(commaBit);
-        if (count==6) DisplayCommas &= ~(commaBit*2);
-      }
+    // Count the significant digits (a value of zero has none)
+    byte numSignificant = 10;
+    while (numSignificant && ((packedBCD[(numSignificant-1)>>1]>>(((numSignificant-1)&0x01)*4))&0x0F)==0) numSignificant -= 1;
+
+    for (byte count=0; count<RPU_OS_NUM_DIGITS; count++) {
+      blank = blank * 2;
+      if (count<numSignificant || count<minDigits) blank |= 1;
+
+      byte digit = packedBCD[count>>1];
+      if (count&0x01) digit = digit>>4;
+      DisplayDigits[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = digit&0x0F;
     }
-#else
-    (void)showCommasByMagnitude;
-#endif    
-    DisplayDigits[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = value%10;
-    value /= 10;
+
+    DisplayValueCache[displayNumber] = value;
+    DisplayMinDigitsCache[displayNumber] = minDigits;
+    DisplayBlankCache[displayNumber] = blank;
   }
 
   if (blankByMagnitude) DisplayDigitEnable[displayNumber] = blank;
@@ -1675,6 +2500,8 @@ byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagni
 
 #if (RPU_MPU_ARCHITECTURE<10)
 void RPU_SetDisplayCredits(int value, boolean displayOn, boolean showBothDigits, boolean sixdigits) {
+  InvalidateDisplayCache(4);
+  StopDisplayBlinkDigits(4, sixdigits ? 0x0C : 0x06);
 if (sixdigits) {
   DisplayDigits[4][2] = (value%100) / 10;
   DisplayDigits[4][3] = (value%10);
@@ -1693,6 +2520,8 @@ if (sixdigits) {
 }
 
 void RPU_SetDisplayBallInPlay(int value, boolean displayOn, boolean showBothDigits, boolean sixdigits) {
+  InvalidateDisplayCache(4);
+  StopDisplayBlinkDigits(4, sixdigits ? 0x60 : 0x30);
 if (sixdigits) {
   DisplayDigits[4][5] = (value%100) / 10;
   DisplayDigits[4][6] = (value%10); 
@@ -1775,6 +2604,33 @@ void RPU_CycleAllDisplays(unsigned long curTime, byte digitNum, boolean sixdigit
     }
   }
 
+#if (RPU_MPU_ARCHITECTURE<15)
+  // The display interrupt steps the digits, so this only
+  // has to keep the cycle (or the 8s) set up
+  (void)curTime;
+  byte cycleMask = RPU_OS_ALL_DIGITS_MASK;
+#if (RPU_OS_NUM_DIGITS==7)
+  // Six digit values leave the first digit at zero
+  if (sixdigits) cycleMask = 0x7E;
+#endif
+  RPU_SetDisplayCycleSequence(0, 9, 250);
+
+  for (int count=0; count<5; count++) {
+    if (display8) {
+      RPU_SetDisplayCycle(count, 0);
+      SetDisplayDigits(count, value, false, 2, false);
+    } else if (DisplayAnimations[count].cycleMask!=cycleMask) {
+      SetDisplayDigits(count, 0, false, 2, false);
+      RPU_SetDisplayCycle(count, cycleMask);
+    }
+    if (digitNum) {
+      if (count==displayNumToShow) SetDisplayEnable(count, displayBlank);
+      else SetDisplayEnable(count, 0);
+    } else {
+      SetDisplayEnable(count, RPU_OS_ALL_DIGITS_MASK);
+    }
+  }
+#else
   for (int count=0; count<5; count++) {
     if (digitNum) {
       RPU_SetDisplay(count, value);
@@ -1785,6 +2641,7 @@ void RPU_CycleAllDisplays(unsigned long curTime, byte digitNum, boolean sixdigit
       RPU_SetDisplayBlank(count, RPU_OS_ALL_DIGITS_MASK);
     }
   }
+#endif
 }
 
 void RPU_SetDisplayMatch(int value, boolean displayOn, boolean showBothDigits) {
@@ -1801,7 +2658,7 @@ void RPU_SetDisplayMatch(int value, boolean displayOn, boolean showBothDigits) {
 // so, looking at it from left to right on the display
 //   digit=  1  2  3  4  5  6
 //   bit=   b0 b1 b2 b3 b4 b5
-void RPU_SetDisplayBlank(int displayNumber, byte bitMask) {
+void SetDisplayEnable(int displayNumber, byte bitMask) {
   if (displayNumber<0 || displayNumber>4) return;
 
 #if (RPU_MPU_ARCHITECTURE>=13) 
@@ -1814,6 +2671,17 @@ void RPU_SetDisplayBlank(int displayNumber, byte bitMask) {
   DisplayDigitEnable[displayNumber] = bitMask;
 }
 
+byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude) {
+  // Setting a display directly ends any animation on it
+  RPU_StopDisplayAnimation(displayNumber);
+  return SetDisplayDigits(displayNumber, value, blankByMagnitude, minDigits, showCommasByMagnitude);
+}
+
+void RPU_SetDisplayBlank(int displayNumber, byte bitMask) {
+  RPU_StopDisplayAnimation(displayNumber);
+  SetDisplayEnable(displayNumber, bitMask);
+}
+
 byte RPU_GetDisplayBlank(int displayNumber) {
   if (displayNumber<0 || displayNumber>4) return 0;
   return DisplayDigitEnable[displayNumber];
@@ -1840,37 +2708,149 @@ void RPU_SetDisplayRefreshConstant(int intervalConstant) {
 
 
 void RPU_SetDisplayFlash(int displayNumber, unsigned long value, unsigned long curTime, int period, byte minDigits) {
-  // A period of zero toggles display every other time
+  // The display interrupt does the flashing, so curTime isn't needed
+  (void)curTime;
   if (period) {
-    if ((curTime/period)%2) {
-      RPU_SetDisplay(displayNumber, value, true, minDigits);
-    } else {
-      RPU_SetDisplayBlank(displayNumber, 0);
-    }
+    SetDisplayDigits(displayNumber, value, true, minDigits, false);
+    RPU_SetDisplayBlink(displayNumber, 0xFF, period);
   }
   
 }
 
 void RPU_SetDisplayFlashCredits(unsigned long curTime, int period) {
+  (void)curTime;
   if (period) {
-    if ((curTime/period)%2) {
-      DisplayDigitEnable[4] |= 0x06;
-    } else {
-      DisplayDigitEnable[4] &= 0x39;
-    }
+    DisplayDigitEnable[4] |= 0x06;
+    RPU_SetDisplayBlink(4, 0x06, period);
   }
 }
 
 
-#if (RPU_MPU_ARCHITECTURE==15)
-byte RPU_SetDisplayText(int displayNumber, char *text, boolean blankByLength) {
-  if (displayNumber>1 || displayNumber<0) return 0;
-  byte stringLength = 0xff;
-  boolean writeSpace = false;
-  byte blank = 0;
-  byte placeMask = 0x01;
-
-  for (stringLength=0; stringLength<RPU_OS_NUM_DIGITS; stringLength++) {
+// Converts a time in ms to a number of display interrupts
+unsigned short DisplayMillisecondsToInterrupts(int milliseconds) {
+#if (RPU_MPU_ARCHITECTURE<10)
+  // Timer1 has a 1/1024 prescaler (15625 counts per second)
+  unsigned long numInterrupts = ((unsigned long)milliseconds * 125) / (8 * ((unsigned long)OCR1A + 1));
+#else
+  // Timer1 has no prescaler
+  unsigned long numInterrupts = ((unsigned long)milliseconds * 16000) / ((unsigned long)OCR1A + 1);
+#endif
+  if (numInterrupts==0) numInterrupts = 1;
+  if (numInterrupts>0xFFFF) numInterrupts = 0xFFFF;
+  return (unsigned short)numInterrupts;
+}
+
+
+// Blinks the digits in blinkMask (same bits as RPU_SetDisplayBlank) on and 
+// off every period ms. Calling this again with the same period keeps the
+// current phase, so it can be called every loop. 
+void RPU_SetDisplayBlink(int displayNumber, byte blinkMask, int period) {
+  if (displayNumber<0 || displayNumber>4) return;
+  if (blinkMask==0) period = 0;
+  volatile DisplayAnimation *animation = &DisplayAnimations[displayNumber];
+  if (animation->blinkMask==blinkMask && animation->blinkPeriodSetting==period) return;
+
+  unsigned short blinkPeriod = period ? DisplayMillisecondsToInterrupts(period) : 0;
+  noInterrupts();
+  if (animation->blinkPeriodSetting!=period) {
+    animation->blinkPeriodSetting = period;
+    animation->blinkPeriod = blinkPeriod;
+    animation->blinkCountdown = blinkPeriod;
+    animation->blinkOn = true;
+  }
+  animation->blinkMask = blinkMask;
+  animation->blinkGate = animation->blinkOn ? 0xFF : ~blinkMask;
+  interrupts();
+}
+
+
+#if (RPU_MPU_ARCHITECTURE<15)
+void WriteDisplayCycleDigits(int displayNumber) {
+  byte cycleMask = DisplayAnimations[displayNumber].cycleMask;
+  for (byte count=0; count<RPU_OS_NUM_DIGITS; count++) {
+    if (cycleMask&0x01) DisplayDigits[displayNumber][count] = DisplayCycleValue;
+    cycleMask = cycleMask>>1;
+  }
+  InvalidateDisplayCache(displayNumber);
+}
+
+// The digits in cycleMask step through the cycle sequence 
+// (see RPU_SetDisplayCycleSequence). A mask of 0 stops cycling.
+void RPU_SetDisplayCycle(int displayNumber, byte cycleMask) {
+  if (displayNumber<0 || displayNumber>4) return;
+  if (DisplayAnimations[displayNumber].cycleMask==cycleMask) return;
+  noInterrupts();
+  DisplayAnimations[displayNumber].cycleMask = cycleMask;
+  WriteDisplayCycleDigits(displayNumber);
+  interrupts();
+}
+
+void RPU_SetDisplayCycleSequence(byte firstDigit, byte lastDigit, int period) {
+  if (DisplayCycleFirst==firstDigit && DisplayCycleLast==lastDigit && DisplayCyclePeriodSetting==period) return;
+  unsigned short cyclePeriod = period ? DisplayMillisecondsToInterrupts(period) : 0;
+  noInterrupts();
+  DisplayCycleFirst = firstDigit;
+  DisplayCycleLast = lastDigit;
+  DisplayCycleValue = firstDigit;
+  DisplayCyclePeriodSetting = period;
+  DisplayCyclePeriod = cyclePeriod;
+  DisplayCycleCountdown = cyclePeriod;
+  interrupts();
+}
+#endif
+
+void RPU_StopDisplayAnimation(int displayNumber) {
+  if (displayNumber<0 || displayNumber>4) return;
+  volatile DisplayAnimation *animation = &DisplayAnimations[displayNumber];
+  if (animation->blinkMask==0 && animation->cycleMask==0) return;
+  noInterrupts();
+  animation->blinkMask = 0;
+  animation->blinkGate = 0xFF;
+  animation->blinkPeriodSetting = 0;
+  animation->blinkPeriod = 0;
+  animation->cycleMask = 0;
+  interrupts();
+}
+
+// Called from the display interrupt
+void UpdateDisplayAnimations() {
+  for (byte count=0; count<5; count++) {
+    volatile DisplayAnimation *animation = &DisplayAnimations[count];
+    if (animation->blinkPeriod) {
+      animation->blinkCountdown -= 1;
+      if (animation->blinkCountdown==0) {
+        animation->blinkCountdown = animation->blinkPeriod;
+        animation->blinkOn = !animation->blinkOn;
+        animation->blinkGate = animation->blinkOn ? 0xFF : ~animation->blinkMask;
+      }
+    }
+  }
+
+#if (RPU_MPU_ARCHITECTURE<15)
+  if (DisplayCyclePeriod) {
+    DisplayCycleCountdown -= 1;
+    if (DisplayCycleCountdown==0) {
+      DisplayCycleCountdown = DisplayCyclePeriod;
+      if (DisplayCycleValue>=DisplayCycleLast) DisplayCycleValue = DisplayCycleFirst;
+      else DisplayCycleValue += 1;
+      for (byte count=0; count<5; count++) {
+        if (DisplayAnimations[count].cycleMask) WriteDisplayCycleDigits(count);
+      }
+    }
+  }
+#endif
+}
+
+
+#if (RPU_MPU_ARCHITECTURE==15)
+byte RPU_SetDisplayText(int displayNumber, char *text, boolean blankByLength) {
+  if (displayNumber>1 || displayNumber<0) return 0;
+  byte stringLength = 0xff;
+  boolean writeSpace = false;
+  byte blank = 0;
+  byte placeMask = 0x01;
+
+  for (stringLength=0; stringLength<RPU_OS_NUM_DIGITS; stringLength++) {
     if (text[stringLength]==0) writeSpace = true;
     if (!writeSpace) DisplayText[displayNumber][stringLength] = (byte)text[stringLength]-0x20;
     else DisplayText[displayNumber][stringLength] = 0;
@@ -1885,7 +2865,7 @@ byte RPU_SetDisplayText(int displayNumber, char *text, boolean blankByLength) {
 }
 
 // Architectures with alpha store numbers as 7-seg
-byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude) {
+byte SetDisplayDigits(int displayNumber, unsigned long value, boolean blankByMagnitude, byte minDigits, boolean showCommasByMagnitude) {
   if (displayNumber<0 || displayNumber>3) return 0;
 
   byte blank = 0x00;
@@ -1894,7 +2874,7 @@ byte RPU_SetDisplay(int displayNumber, unsigned long value, boolean blankByMagni
     blank = blank * 2;
     if (value!=0 || count<minDigits) {
       blank |= 1;
-      if (displayNumber/2) DisplayDigits[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = SevenSegmentNumbers[value%10];
+      if (displayNumber/2) DisplayDigits[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = pgm_read_word(&SevenSegmentNumbers[value%10]);
       else DisplayText[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = (value%10)+16;
     } else {
       if (displayNumber/2) DisplayDigits[displayNumber][(RPU_OS_NUM_DIGITS-1)-count] = 0;
@@ -1913,13 +2893,13 @@ void RPU_SetDisplayCredits(int value, boolean displayOn, boolean showBothDigits)
   byte blank = 0x02;
   value = value % 100;
   if (value>=10) {
-    DisplayCreditDigits[0] = SevenSegmentNumbers[value/10];
+    DisplayCreditDigits[0] = pgm_read_word(&SevenSegmentNumbers[value/10]);
     blank |= 1;
   } else {
-    DisplayCreditDigits[0] = SevenSegmentNumbers[0];
+    DisplayCreditDigits[0] = pgm_read_word(&SevenSegmentNumbers[0]);
     if (showBothDigits) blank |= 1;
   }
-  DisplayCreditDigits[1] = SevenSegmentNumbers[value%10];
+  DisplayCreditDigits[1] = pgm_read_word(&SevenSegmentNumbers[value%10]);
   if (displayOn) DisplayCreditDigitEnable = blank;
   else DisplayCreditDigitEnable = 0;
 }
@@ -1928,13 +2908,13 @@ void RPU_SetDisplayBallInPlay(int value, boolean displayOn, boolean showBothDigi
   byte blank = 0x02;
   value = value % 100;
   if (value>=10) {
-    DisplayBIPDigits[0] = SevenSegmentNumbers[value/10];
+    DisplayBIPDigits[0] = pgm_read_word(&SevenSegmentNumbers[value/10]);
     blank |= 1;
   } else {
-    DisplayBIPDigits[0] = SevenSegmentNumbers[0];
+    DisplayBIPDigits[0] = pgm_read_word(&SevenSegmentNumbers[0]);
     if (showBothDigits) blank |= 1;
   }
-  DisplayBIPDigits[1] = SevenSegmentNumbers[value%10];
+  DisplayBIPDigits[1] = pgm_read_word(&SevenSegmentNumbers[value%10]);
   if (displayOn) DisplayBIPDigitEnable = blank;
   else DisplayBIPDigitEnable = 0;  
 }
@@ -1952,19 +2932,26 @@ void RPU_SetDimDivisor(byte level, byte divisor) {
 }
 
 // left shift is iterative on Arduinos, so a bit array is suprisingly faster
-byte BitShiftValues[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+// (and it's kept in flash so it doesn't take up SRAM)
+const byte BitShiftValues[8] PROGMEM = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
+// LampFlashPeriod is kept in 50ms units
+byte AdjustedLampFlash(int s_lampFlashPeriod) {
+  int adjustedLampFlash = s_lampFlashPeriod/50;
+    
+  if (s_lampFlashPeriod!=0 && adjustedLampFlash==0) adjustedLampFlash = 1;
+  if (adjustedLampFlash>250) adjustedLampFlash = 250;
+  return adjustedLampFlash;
+}
 
 void RPU_SetLampState(int lampNum, byte s_lampState, byte s_lampDim, int s_lampFlashPeriod) {
   if (lampNum>=RPU_MAX_LAMPS || lampNum<0) return;
   byte lampRow = lampNum%8;
   byte lampCol = lampNum/8;
-  byte lampBit = BitShiftValues[lampRow];
+  byte lampBit = pgm_read_byte(&BitShiftValues[lampRow]);
 
   if (s_lampState) {
-    int adjustedLampFlash = s_lampFlashPeriod/50;
-    
-    if (s_lampFlashPeriod!=0 && adjustedLampFlash==0) adjustedLampFlash = 1;
-    if (adjustedLampFlash>250) adjustedLampFlash = 250;
+    byte adjustedLampFlash = AdjustedLampFlash(s_lampFlashPeriod);
     
     // Only turn on the lamp if there's no flash, because if there's a flash
     // then the lamp will be turned on by the ApplyFlashToLamps function
@@ -2013,11 +3000,45 @@ int RPU_ReadLampFlash(int lampNum) {
   return LampFlashPeriod[lampNum]*50;
 }
 
+void RPU_BeginLampFrame() {
+  LampFrameDepth += 1;
+  if (LampFrameDepth>1) return;
+
+  byte oldSREG = SREG;
+  cli();
+  if (LampFramePending) {
+    // The last frame hasn't been shown yet, so carry on composing it
+    LampFramePending = false;
+  } else if (LampStates==LampStateBuffers[LampFrontBuffer]) {
+    volatile byte *backBuffer = LampStateBuffers[LampFrontBuffer^1];
+    for (byte bankCount=0; bankCount<RPU_NUM_LAMP_BANKS; bankCount++) backBuffer[bankCount] = LampStates[bankCount];
+    LampStates = backBuffer;
+  }
+  SREG = oldSREG;
+}
+
+void RPU_CommitLampFrame() {
+  if (LampFrameDepth==0) return;
+  LampFrameDepth -= 1;
+  if (LampFrameDepth==0 && LampStates!=LampStateBuffers[LampFrontBuffer]) LampFramePending = true;
+}
+
+// Called by the interrupts at the start of a lamp pass
+volatile byte *StartLampPass() {
+  if (LampFramePending) {
+    LampFrontBuffer ^= 1;
+    LampFramePending = false;
+  }
+  return LampStateBuffers[LampFrontBuffer];
+}
+
 void RPU_ApplyFlashToLamps(unsigned long curTime) {
   int curLampByte = 0;
   byte curLampBit = 0;
   int curLampNum = 0;
 
+  RPU_BeginLampFrame();
+
   for (curLampByte=0; curLampByte<RPU_NUM_LAMP_BANKS; curLampByte++) {
     curLampBit = 0x01;
     for (byte curBit=0; curBit<8; curBit++) {
@@ -2034,24 +3055,208 @@ void RPU_ApplyFlashToLamps(unsigned long curTime) {
       curLampNum += 1;
     }
   }
+
+  RPU_CommitLampFrame();
 }
 
-void RPU_FlashAllLamps(unsigned long curTime) {
-  for (int count=0; count<RPU_MAX_LAMPS; count++) {
-    RPU_SetLampState(count, 1, 0, 500);  
+// Bank functions - each bit of a mask is one lamp in the bank 
+// (bit 0 is lamp bankNum*8), and only lamps in lampMask are changed
+void RPU_SetLampBank(byte bankNum, byte lampsOn, byte lampMask) {
+  if (bankNum>=RPU_NUM_LAMP_BANKS) return;
+  // LampStates is active low
+  LampStates[bankNum] = (LampStates[bankNum] & ~lampMask) | (~lampsOn & lampMask);
+  LampDim1[bankNum] &= ~lampMask;
+  LampDim2[bankNum] &= ~lampMask;
+  RPU_SetLampBankFlash(bankNum, 0, lampMask);
+}
+
+void RPU_SetLampBankDim(byte bankNum, byte lampDim1, byte lampDim2, byte lampMask) {
+  if (bankNum>=RPU_NUM_LAMP_BANKS) return;
+  LampDim1[bankNum] = (LampDim1[bankNum] & ~lampMask) | (lampDim1 & lampMask);
+  LampDim2[bankNum] = (LampDim2[bankNum] & ~lampMask) | (lampDim2 & lampMask);
+}
+
+void RPU_SetLampBankFlash(byte bankNum, int s_lampFlashPeriod, byte lampMask) {
+  if (bankNum>=RPU_NUM_LAMP_BANKS || lampMask==0) return;
+  byte adjustedLampFlash = AdjustedLampFlash(s_lampFlashPeriod);
+  int lampNum = bankNum*8;
+  for (byte lampBit=0x01; lampBit!=0 && lampNum<RPU_MAX_LAMPS; lampBit<<=1, lampNum++) {
+    if (lampMask & lampBit) LampFlashPeriod[lampNum] = adjustedLampFlash;
   }
+}
 
+// Same as calling RPU_SetLampState for lamps 0 to numLamps-1, but a bank at a time
+void RPU_FillAllLamps(byte s_lampState, byte s_lampDim, int s_lampFlashPeriod, int numLamps) {
+  if (numLamps>RPU_MAX_LAMPS) numLamps = RPU_MAX_LAMPS;
+  if (numLamps<=0) return;
+
+  byte adjustedLampFlash = s_lampState ? AdjustedLampFlash(s_lampFlashPeriod) : 0;
+  byte dim1 = (s_lampDim & 0x01) ? 0xFF : 0x00;
+  byte dim2 = (s_lampDim & 0x02) ? 0xFF : 0x00;
+
+  RPU_BeginLampFrame();
+  for (byte bankNum=0; bankNum*8<numLamps; bankNum++) {
+    byte lampMask = 0xFF;
+    if ((numLamps - bankNum*8) < 8) lampMask = pgm_read_byte(&BitShiftValues[numLamps - bankNum*8]) - 1;
+
+    // Flashing lamps are turned on by RPU_ApplyFlashToLamps
+    if (!s_lampState) LampStates[bankNum] |= lampMask;
+    else if (adjustedLampFlash==0) LampStates[bankNum] &= ~lampMask;
+    LampDim1[bankNum] = (LampDim1[bankNum] & ~lampMask) | (dim1 & lampMask);
+    LampDim2[bankNum] = (LampDim2[bankNum] & ~lampMask) | (dim2 & lampMask);
+  }
+
+  RPU_CommitLampFrame();
+
+  for (int lampNum=0; lampNum<numLamps; lampNum++) LampFlashPeriod[lampNum] = adjustedLampFlash;
+}
+
+void RPU_FlashAllLamps(unsigned long curTime) {
+  RPU_FillAllLamps(1, 0, 500);
   RPU_ApplyFlashToLamps(curTime);
 }
 
 void RPU_TurnOffAllLamps() {
-  for (int count=0; count<RPU_MAX_LAMPS; count++) {
-    RPU_SetLampState(count, 0, 0, 0);  
+  RPU_FillAllLamps(0);
+}
+
+
+// Lamp shows
+// A show is either a list of frames in PROGMEM (see RPU_LAMP_SHOW_DURATION in RPU.h)
+// or one of the built-in shows, which are generated from the number of lamp banks.
+// RPU_UpdateLampShow writes a whole frame to LampStates at once and does
+// nothing between frames.
+const byte *LampShowFrames = NULL;
+byte LampShowBuiltIn = RPU_LAMP_SHOW_NONE;
+unsigned short LampShowNumFrames = 0;
+unsigned short LampShowFrame = 0;
+unsigned short LampShowFrameDuration = 0;
+boolean LampShowLoop = false;
+boolean LampShowRunning = false;
+boolean LampShowStarting = false;
+unsigned long LampShowNextFrameTime = 0;
+
+void StartLampShow(boolean loopShow) {
+  // Lamp shows own all the lamps while they run
+  RPU_TurnOffAllLamps();
+  LampShowFrame = 0;
+  LampShowLoop = loopShow;
+  LampShowStarting = true;
+  LampShowRunning = (LampShowNumFrames!=0);
+}
+
+void RPU_PlayLampShow(const byte *showFrames, unsigned short numFrames, boolean loopShow) {
+  LampShowFrames = showFrames;
+  LampShowBuiltIn = RPU_LAMP_SHOW_NONE;
+  LampShowNumFrames = numFrames;
+  StartLampShow(loopShow);
+}
+
+void RPU_PlayBuiltInLampShow(byte showNum, unsigned short frameDuration, boolean loopShow) {
+  LampShowFrames = NULL;
+  LampShowBuiltIn = showNum;
+  LampShowFrameDuration = frameDuration;
+  if (showNum==RPU_LAMP_SHOW_ROWS) LampShowNumFrames = 8;
+  else if (showNum==RPU_LAMP_SHOW_COLUMNS) LampShowNumFrames = RPU_NUM_LAMP_BANKS;
+  else if (showNum==RPU_LAMP_SHOW_CHASE) LampShowNumFrames = RPU_MAX_LAMPS;
+  else LampShowNumFrames = 0;
+  StartLampShow(loopShow);
+}
+
+// Leaves the lamps as they are
+void RPU_StopLampShow() {
+  LampShowRunning = false;
+  LampShowBuiltIn = RPU_LAMP_SHOW_NONE;
+}
+
+boolean RPU_IsLampShowRunning() {
+  return LampShowRunning;
+}
+
+void RPU_UpdateLampShow(unsigned long curTime) {
+  if (!LampShowRunning) return;
+  if (!LampShowStarting && (long)(curTime - LampShowNextFrameTime) < 0) return;
+  LampShowStarting = false;
+
+  unsigned short frameDuration;
+  RPU_BeginLampFrame();
+  if (LampShowFrames!=NULL) {
+    const byte *frame = LampShowFrames + (unsigned long)LampShowFrame*RPU_LAMP_SHOW_FRAME_SIZE;
+    frameDuration = pgm_read_byte(frame) | (((unsigned short)pgm_read_byte(frame+1))<<8);
+    for (byte bankCount=0; bankCount<RPU_NUM_LAMP_BANKS; bankCount++) {
+      // Lamp states are active low
+      LampStates[bankCount] = ~pgm_read_byte(frame+2+bankCount);
+    }
+  } else {
+    frameDuration = LampShowFrameDuration;
+    for (byte bankCount=0; bankCount<RPU_NUM_LAMP_BANKS; bankCount++) {
+      byte bankLamps = 0x00;
+      if (LampShowBuiltIn==RPU_LAMP_SHOW_ROWS) bankLamps = pgm_read_byte(&BitShiftValues[LampShowFrame]);
+      else if (LampShowBuiltIn==RPU_LAMP_SHOW_COLUMNS && bankCount==LampShowFrame) bankLamps = 0xFF;
+      else if (LampShowBuiltIn==RPU_LAMP_SHOW_CHASE && bankCount==LampShowFrame/8) bankLamps = pgm_read_byte(&BitShiftValues[LampShowFrame%8]);
+      LampStates[bankCount] = ~bankLamps;
+    }
+  }
+  RPU_CommitLampFrame();
+  LampShowNextFrameTime = curTime + frameDuration;
+
+  LampShowFrame += 1;
+  if (LampShowFrame>=LampShowNumFrames) {
+    LampShowFrame = 0;
+    if (!LampShowLoop) LampShowRunning = false;
   }
 }
 
 
 
+/******************************************************
+ *   SRAM Usage
+ */
+
+// Free SRAM (between the heap and the stack) is painted at 
+// startup, so the deepest the stack has been can be found
+// later by looking for the first byte that's been overwritten
+#define RPU_STACK_PAINT_BYTE  0xC5
+
+extern char __heap_start;
+extern char *__brkval;
+
+char *SRAMHeapEnd() {
+  return (__brkval==0) ? &__heap_start : __brkval;
+}
+
+void RPU_PaintStack() {
+  // Leave some room for this function's own frame
+  char *paintEnd = ((char *)(uintptr_t)SP) - 16;
+  for (char *paint=SRAMHeapEnd(); paint<paintEnd; paint++) *paint = RPU_STACK_PAINT_BYTE;
+}
+
+// Bytes between the heap and the stack right now
+unsigned int RPU_GetFreeSRAM() {
+  return (unsigned int)(((char *)(uintptr_t)SP) - SRAMHeapEnd());
+}
+
+// Bytes the stack has never reached since RPU_PaintStack
+unsigned int RPU_GetUnusedSRAM() {
+  char *heapEnd = SRAMHeapEnd();
+  char *stackPointer = (char *)(uintptr_t)SP;
+  char *untouched = heapEnd;
+  while (untouched<stackPointer && *untouched==RPU_STACK_PAINT_BYTE) untouched++;
+  return (unsigned int)(untouched - heapEnd);
+}
+
+// Deepest stack excursion (in bytes) since RPU_PaintStack
+unsigned int RPU_GetStackHighWater() {
+  return (unsigned int)((RAMEND + 1) - ((uintptr_t)SRAMHeapEnd() + RPU_GetUnusedSRAM()));
+}
+
+// Size of the global variables (.data and .bss)
+unsigned int RPU_GetStaticSRAM() {
+  return (unsigned int)((uintptr_t)&__heap_start - RAMSTART);
+}
+
+
+
 /******************************************************
  *   Helper Functions
  */
@@ -2079,13 +3284,23 @@ void RPU_ClearVariables() {
       DisplayDigits[displayCount][digitCount] = 0;
     }
     DisplayDigitEnable[displayCount] = 0x00;
+    RPU_StopDisplayAnimation(displayCount);
+#if (RPU_MPU_ARCHITECTURE<15)
+    InvalidateDisplayCache(displayCount);
+#endif
   }
 #if (RPU_MPU_ARCHITECTURE>=13)  
   DisplayCommas = 0x00;
 #endif
 
   // Turn off all lamp states
+  LampShowRunning = false;
+  LampStates = LampStateBuffers[0];
+  LampFrontBuffer = 0;
+  LampFramePending = false;
+  LampFrameDepth = 0;
   for (int lampBankCounter=0; lampBankCounter<RPU_NUM_LAMP_BANKS; lampBankCounter++) {
+    LampStateBuffers[1][lampBankCounter] = 0xFF;
     LampStates[lampBankCounter] = 0xFF;
     LampDim1[lampBankCounter] = 0x00;
     LampDim2[lampBankCounter] = 0x00;
@@ -2099,10 +3314,11 @@ void RPU_ClearVariables() {
   // (set them as closed so that if they're stuck they don't register as new events)
   byte switchCount;
   for (switchCount=0; switchCount<NUM_SWITCH_BYTES; switchCount++) {
-    SwitchesMinus2[switchCount] = 0xFF;
-    SwitchesMinus1[switchCount] = 0xFF;
     SwitchesNow[switchCount] = 0xFF;
+    SwitchesLastScan[switchCount] = 0xFF;
+    for (byte plane=0; plane<RPU_OS_SWITCH_DEBOUNCE_PLANES; plane++) SwitchClosedCount[plane][switchCount] = 0xFF;
   }
+  RPU_SetAllSwitchDebounce(RPU_SWITCH_DEBOUNCE_DEFAULT);
 
   for (byte count=0; count<TIMED_SOLENOID_STACK_SIZE; count++) {
     TimedSolenoidStack[count].inUse = 0;
@@ -2129,15 +3345,156 @@ void RPU_ClearVariables() {
 /******************************************************
  *   Sound Handling Functions
  */
+
+#ifdef RPU_OS_QUEUED_SOUND_BYTES
+// S&T and -51 sound bytes are clocked into U11B by Timer3, one phase per
+// compare match (latch low, lower nibble, upper nibble, restore), so playing
+// a sound only queues it. While a byte is going out, CurrentSolenoidByte
+// changes aren't written to U11B - the restore phase writes the latest one.
+// Interrupt handlers don't nest, so each phase is one bus-safe chunk. A byte
+// is only started when it can finish before the display interrupt or the
+// next zero crossing is due (see BusQuietFor), so the whole byte stays out
+// of their bus windows and their handlers can't stretch its phases.
+#define SOUND_QUEUE_SIZE          16
+#define SOUND_BOARD_S_AND_T       0
+#define SOUND_BOARD_DASH51        1
+#define SOUND_PHASE_IDLE          0xFF
+// Longest byte (S&T: 32 + 138 + 145 us) with some room to spare
+#define SOUND_BYTE_WINDOW         400
+// How soon to look again when there's no room for a byte
+#define SOUND_BYTE_RETRY          48
+// With the 1/64 prescaler each count is 4 us
+#define SOUND_TIMER_COUNT(us)     ((unsigned int)(((us)/4)-1))
+struct SoundQueueEntry {
+  byte soundByte;
+  byte soundBoard;
+};
+volatile SoundQueueEntry SoundQueue[SOUND_QUEUE_SIZE];
+volatile byte SoundQueueFirst = 0;
+volatile byte SoundQueueLast = 0;
+volatile byte SoundPhase = SOUND_PHASE_IDLE;
+SoundQueueEntry SoundOut;
+byte SoundOutOldDisplayBit;
+void RecordInterruptChunk(unsigned long chunkStart);
+boolean BusQuietFor(unsigned int microseconds);
+
+void PushToSoundQueue(byte soundByte, byte soundBoard) {
+  byte oldSREG = SREG;
+  cli();
+  byte nextLast = SoundQueueLast + 1;
+  if (nextLast>=SOUND_QUEUE_SIZE) nextLast = 0;
+  // If the queue is full, the sound is dropped
+  if (nextLast!=SoundQueueFirst) {
+    SoundQueue[SoundQueueLast].soundByte = soundByte;
+    SoundQueue[SoundQueueLast].soundBoard = soundBoard;
+    SoundQueueLast = nextLast;
+    if (SoundPhase==SOUND_PHASE_IDLE) {
+      // Start Timer3 (CTC, 1/64 prescaler) - the first phase runs right away
+      SoundPhase = 0;
+      TCCR3B = 0;
+      TCCR3A = 0;
+      TCNT3 = 0;
+      OCR3A = SOUND_TIMER_COUNT(8);
+      TIFR3 = (1<<OCF3A);
+      TIMSK3 |= (1<<OCIE3A);
+      TCCR3B = (1<<WGM32) | (1<<CS31) | (1<<CS30);
+    }
+  }
+  SREG = oldSREG;
+}
+
+// Does one phase of the byte going out and returns the time 
+// to the next phase in microseconds (0 when the queue is empty)
+unsigned int ClockOutSoundPhase() {
+  if (SoundPhase==0) {
+    if (SoundQueueFirst==SoundQueueLast) return 0;
+    if (!BusQuietFor(SOUND_BYTE_WINDOW)) return SOUND_BYTE_RETRY;
+    SoundOut.soundByte = SoundQueue[SoundQueueFirst].soundByte;
+    SoundOut.soundBoard = SoundQueue[SoundQueueFirst].soundBoard;
+    SoundQueueFirst += 1;
+    if (SoundQueueFirst>=SOUND_QUEUE_SIZE) SoundQueueFirst = 0;
+    SoundTransferActive = true;
+
+    // Put 1s on momentary solenoid lines
+    RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte | 0x0F);
+    // Put sound latch low
+    RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
+    SoundPhase = 1;
+    // Let the strobe stay low for a moment
+    return (SoundOut.soundBoard==SOUND_BOARD_DASH51) ? 68 : 32;
+  }
+
+  if (SoundPhase==1) {
+    if (SoundOut.soundBoard==SOUND_BOARD_DASH51) {
+      // put bit 4 on Display Enable 7
+      byte displayByte = RPU_DataRead(ADDRESS_U11_A);
+      SoundOutOldDisplayBit = displayByte & 0x02;
+      if (SoundOut.soundByte & 0x10) displayByte |= 0x02;
+      else displayByte &= 0xFD;
+      RPU_DataWrite(ADDRESS_U11_A, displayByte);
+    }
+    // Put sound latch high
+    RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x3C);
+    // put the new byte on U11:PortB (the lower nibble is currently loaded)
+    RPU_DataWrite(ADDRESS_U11_B, (CurrentSolenoidByte&0xF0) | (SoundOut.soundByte&0x0F));
+    if (SoundOut.soundBoard==SOUND_BOARD_DASH51) {
+      SoundPhase = 3;
+      return 180;
+    }
+    SoundPhase = 2;
+    return 138;
+  }
+
+  if (SoundPhase==2) {
+    // put the new byte on U11:PortB (the upper nibble is currently loaded)
+    RPU_DataWrite(ADDRESS_U11_B, (CurrentSolenoidByte&0xF0) | (SoundOut.soundByte/16));
+    SoundPhase = 3;
+    return 145;
+  }
+
+  // Restore the solenoid byte (and display byte for -51)
+  RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  if (SoundOut.soundBoard==SOUND_BOARD_DASH51) {
+    RPU_DataWrite(ADDRESS_U11_A, (RPU_DataRead(ADDRESS_U11_A) & 0xFD) | SoundOutOldDisplayBit);
+  }
+  // Put sound latch low
+  RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
+  SoundTransferActive = false;
+  SoundPhase = 0;
+  // Give the sound board a moment before the next byte
+  return (SoundQueueFirst==SoundQueueLast) ? 0 : 100;
+}
+
+// INTERRUPT SERVICE ROUTINE
+// for the sound byte queue (Timer3)
+ISR(TIMER3_COMPA_vect) {
+  unsigned long chunkStart = micros();
+  unsigned int nextPhaseTime = ClockOutSoundPhase();
+  if (nextPhaseTime) {
+    TCNT3 = 0;
+    OCR3A = SOUND_TIMER_COUNT(nextPhaseTime);
+  } else {
+    TCCR3B = 0;
+    TIMSK3 &= ~(1<<OCIE3A);
+    SoundPhase = SOUND_PHASE_IDLE;
+  }
+  RecordInterruptChunk(chunkStart);
+}
+#endif
  
 #ifdef RPU_OS_USE_S_AND_T
 
+#ifdef RPU_OS_QUEUED_SOUND_BYTES
+void RPU_PlaySoundSAndT(byte soundByte) {
+  PushToSoundQueue(soundByte, SOUND_BOARD_S_AND_T);
+}
+#else
 void RPU_PlaySoundSAndT(byte soundByte) {
 
   byte oldSolenoidControlByte, soundLowerNibble, soundUpperNibble;
 
   // mask further zero-crossing interrupts during this 
-  noInterrupts();
+  byte oldSREG = LockBusBetweenStrobes();
 
   // Get the current value of U11:PortB - current solenoids
   oldSolenoidControlByte = RPU_DataRead(ADDRESS_U11_B);
@@ -2174,9 +3531,10 @@ void RPU_PlaySoundSAndT(byte soundByte) {
   // Put sound latch low
   RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
 
-  interrupts();
+  SREG = oldSREG;
 }
 #endif
+#endif
 
 // With hardware rev 1, this function relies on D13 being connected to A5 because it writes to address 0xA0
 // A0  - A0   0
@@ -2226,10 +3584,13 @@ void RPU_PlaySoundDash51(byte soundByte) {
   // for timing controls.
   // For ease of use, I've mapped the sounds from 0-31
   
+#ifdef RPU_OS_QUEUED_SOUND_BYTES
+  PushToSoundQueue(soundByte, SOUND_BOARD_DASH51);
+#else
   byte oldSolenoidControlByte, soundLowerNibble, displayWithSoundBit4, oldDisplayByte;
 
   // mask further zero-crossing interrupts during this 
-  noInterrupts();
+  byte oldSREG = LockBusBetweenStrobes();
 
   // Get the current value of U11:PortB - current solenoids
   oldSolenoidControlByte = RPU_DataRead(ADDRESS_U11_B);
@@ -2269,7 +3630,8 @@ void RPU_PlaySoundDash51(byte soundByte) {
   // Put sound latch low
   RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
 
-  interrupts();
+  SREG = oldSREG;
+#endif
 }
 
 #endif
@@ -2433,6 +3795,204 @@ void RPU_WriteULToEEProm(unsigned short startByte, unsigned long value) {
 
 
 
+/******************************************************
+ *   ROM Checksums
+ */
+
+// CRC-32 (same as zip) a nibble at a time, so the table is only 64 bytes
+const unsigned long CRC32NibbleTable[16] PROGMEM = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Start with crc = 0 and pass the result back in to continue
+unsigned long RPU_CRC32(unsigned long crc, byte *data, int numBytes) {
+  crc = ~crc;
+  for (int count=0; count<numBytes; count++) {
+    crc ^= data[count];
+    crc = (crc>>4) ^ pgm_read_dword(&CRC32NibbleTable[crc&0x0F]);
+    crc = (crc>>4) ^ pgm_read_dword(&CRC32NibbleTable[crc&0x0F]);
+  }
+  return ~crc;
+}
+
+// Returns 0 if every byte read the same (nothing on the bus, or a blank ROM)
+unsigned long RPU_GetROMCRC32(int startAddress, int numBytes) {
+  byte buffer[RPU_DATA_READ_BLOCK_CHUNK];
+  unsigned long crc = 0;
+  boolean allSame = true;
+  byte firstByte = RPU_DataRead(startAddress);
+
+  while (numBytes>0) {
+    int chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    RPU_DataReadBlock(startAddress, buffer, chunkSize);
+    for (int count=0; count<chunkSize && allSame; count++) {
+      if (buffer[count]!=firstByte) allSame = false;
+    }
+    crc = RPU_CRC32(crc, buffer, chunkSize);
+    startAddress += chunkSize;
+    numBytes -= chunkSize;
+  }
+
+  return allSame ? 0 : crc;
+}
+
+
+#if (RPU_MPU_ARCHITECTURE<10)
+/******************************************************
+ *   MPU RAM Test
+ */
+
+// Checks the cells read back by one chunk of a march element, keeping the first failure
+unsigned int RAMTestFailures;
+int RAMTestFailAddress;
+byte RAMTestFailBits;
+
+void CheckRAMCells(int address, byte *readBuffer, int numBytes, boolean descending, byte dataMask, byte expected) {
+  for (int count=0; count<numBytes; count++) {
+    byte actual = readBuffer[count] & dataMask;
+    if (actual!=expected) {
+      if (RAMTestFailures==0) {
+        RAMTestFailAddress = descending ? (address - count) : (address + count);
+        RAMTestFailBits = actual ^ expected;
+      }
+      RAMTestFailures += 1;
+    }
+  }
+}
+
+// One read-then-write march element over the whole range, a chunk at a time
+void MarchRAMElement(int startAddress, int endAddress, boolean descending, byte dataMask, byte expected, byte writeValue) {
+  byte readBuffer[RPU_DATA_READ_BLOCK_CHUNK];
+  int address = descending ? endAddress : startAddress;
+  int numBytes = endAddress - startAddress + 1;
+  while (numBytes>0) {
+    int chunkSize = (numBytes>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : numBytes;
+    RPU_DataReadWriteBlock(address, readBuffer, writeValue, chunkSize, descending);
+    CheckRAMCells(address, readBuffer, chunkSize, descending, dataMask, expected);
+    address += descending ? -chunkSize : chunkSize;
+    numBytes -= chunkSize;
+  }
+}
+
+// March C- over numBytes cells from startAddress, with each data background:
+//   up(w0) up(r0,w1) up(r1,w0) down(r0,w1) down(r1,w0) up(r0)
+// dataMask is the bits the RAM has (0x0F for the 5101). If preserveContents
+// is set, the RAM is put back afterwards (up to 128 bytes, or 256 nibbles).
+// Each element goes through the block accessors, so interrupts are held off
+// a chunk at a time and can't take the bus in the middle of a cell.
+// Returns the number of failed reads - the first failure goes in failAddress / failBits.
+const byte RAMTestBackgrounds[4] PROGMEM = {0x00, 0x55, 0x33, 0x0F};
+
+unsigned int RPU_TestRAM(int startAddress, int numBytes, byte dataMask, int *failAddress, byte *failBits, boolean preserveContents) {
+  byte savedContents[128];
+  byte readBuffer[RPU_DATA_READ_BLOCK_CHUNK];
+  boolean packNibbles = (dataMask<=0x0F);
+  if (numBytes>(packNibbles?256:128)) preserveContents = false;
+
+  if (preserveContents) {
+    for (int count=0; count<numBytes; count+=RPU_DATA_READ_BLOCK_CHUNK) {
+      int chunkSize = ((numBytes-count)>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : (numBytes-count);
+      RPU_DataReadBlock(startAddress+count, readBuffer, chunkSize);
+      for (int cell=0; cell<chunkSize; cell++) {
+        byte data = readBuffer[cell] & dataMask;
+        int index = count + cell;
+        if (!packNibbles) savedContents[index] = data;
+        else if (index&0x01) savedContents[index/2] |= (data<<4);
+        else savedContents[index/2] = data;
+      }
+    }
+  }
+
+  RAMTestFailures = 0;
+  RAMTestFailAddress = 0;
+  RAMTestFailBits = 0;
+  int endAddress = startAddress + numBytes - 1;
+
+  for (byte backgroundCount=0; backgroundCount<4; backgroundCount++) {
+    byte zeros = pgm_read_byte(&RAMTestBackgrounds[backgroundCount]) & dataMask;
+    byte ones = (~zeros) & dataMask;
+
+    RPU_DataFillBlock(startAddress, zeros, numBytes);
+    MarchRAMElement(startAddress, endAddress, false, dataMask, zeros, ones);
+    MarchRAMElement(startAddress, endAddress, false, dataMask, ones, zeros);
+    MarchRAMElement(startAddress, endAddress, true, dataMask, zeros, ones);
+    MarchRAMElement(startAddress, endAddress, true, dataMask, ones, zeros);
+    for (int count=0; count<numBytes; count+=RPU_DATA_READ_BLOCK_CHUNK) {
+      int chunkSize = ((numBytes-count)>RPU_DATA_READ_BLOCK_CHUNK) ? RPU_DATA_READ_BLOCK_CHUNK : (numBytes-count);
+      RPU_DataReadBlock(startAddress+count, readBuffer, chunkSize);
+      CheckRAMCells(startAddress+count, readBuffer, chunkSize, false, dataMask, zeros);
+    }
+  }
+
+  if (preserveContents) {
+    for (int count=0; count<numBytes; count+=RPU_DATA_READ_BLOCK_CHUNK) {
+      int chunkEnd = ((numBytes-count)>RPU_DATA_READ_BLOCK_CHUNK) ? (count+RPU_DATA_READ_BLOCK_CHUNK) : numBytes;
+      byte oldSREG = SREG;
+      cli();
+      for (int cell=count; cell<chunkEnd; cell++) {
+        byte data = packNibbles ? ((cell&0x01) ? (savedContents[cell/2]>>4) : (savedContents[cell/2]&0x0F)) : savedContents[cell];
+        RPU_DataWrite(startAddress+cell, data);
+      }
+      SREG = oldSREG;
+    }
+  }
+
+  if (failAddress) *failAddress = RAMTestFailAddress;
+  if (failBits) *failBits = RAMTestFailBits;
+  return RAMTestFailures;
+}
+#endif
+
+#if (RPU_MPU_ARCHITECTURE<10)
+/******************************************************
+ *   Bus Timing
+ */
+// Pauses the interrupts add around PIA accesses, in microseconds. They start
+// at the compiled defaults and are replaced by the settings saved in EEPROM
+// (RPU_EEPROM_BUS_TIMING). The latches are write-only and the PIA reads are
+// paced by PHI2 whatever the pauses are, so nothing here can tell a setting
+// that's too short - they're set by hand on the diagnostics page, where the
+// operator watches the lamps and displays before saving them.
+#define BUS_TIMING_EEPROM_SIGNATURE     0xB7
+#ifdef RPU_SLOW_DOWN_LAMP_STROBE
+byte LampStrobePadding = 2;
+#else
+byte LampStrobePadding = 0;
+#endif
+byte DisplayLatchDelay = RPU_BUS_TIMING_MAX_DISPLAY_LATCH;
+
+void RPU_GetBusTiming(byte *lampStrobePadding, byte *displayLatchDelay) {
+  if (lampStrobePadding) *lampStrobePadding = LampStrobePadding;
+  if (displayLatchDelay) *displayLatchDelay = DisplayLatchDelay;
+}
+
+void RPU_SetBusTiming(byte lampStrobePadding, byte displayLatchDelay, boolean saveToEEProm) {
+  if (lampStrobePadding>RPU_BUS_TIMING_MAX_LAMP_PADDING) lampStrobePadding = RPU_BUS_TIMING_MAX_LAMP_PADDING;
+  if (displayLatchDelay>RPU_BUS_TIMING_MAX_DISPLAY_LATCH) displayLatchDelay = RPU_BUS_TIMING_MAX_DISPLAY_LATCH;
+  if (displayLatchDelay<RPU_BUS_TIMING_MIN_DISPLAY_LATCH) displayLatchDelay = RPU_BUS_TIMING_MIN_DISPLAY_LATCH;
+  LampStrobePadding = lampStrobePadding;
+  DisplayLatchDelay = displayLatchDelay;
+
+  if (saveToEEProm) {
+    RPU_WriteByteToEEProm(RPU_EEPROM_BUS_TIMING, BUS_TIMING_EEPROM_SIGNATURE);
+    RPU_WriteByteToEEProm(RPU_EEPROM_BUS_TIMING+1, lampStrobePadding);
+    RPU_WriteByteToEEProm(RPU_EEPROM_BUS_TIMING+2, displayLatchDelay);
+    RPU_WriteByteToEEProm(RPU_EEPROM_BUS_TIMING+3, lampStrobePadding ^ displayLatchDelay ^ BUS_TIMING_EEPROM_SIGNATURE);
+  }
+}
+
+void LoadBusTiming() {
+  if (RPU_ReadByteFromEEProm(RPU_EEPROM_BUS_TIMING)!=BUS_TIMING_EEPROM_SIGNATURE) return;
+  byte lampStrobePadding = RPU_ReadByteFromEEProm(RPU_EEPROM_BUS_TIMING+1);
+  byte displayLatchDelay = RPU_ReadByteFromEEProm(RPU_EEPROM_BUS_TIMING+2);
+  if (RPU_ReadByteFromEEProm(RPU_EEPROM_BUS_TIMING+3)!=(lampStrobePadding ^ displayLatchDelay ^ BUS_TIMING_EEPROM_SIGNATURE)) return;
+  RPU_SetBusTiming(lampStrobePadding, displayLatchDelay);
+}
+#endif
+
+
+
 /******************************************************
  *   Initialization and ISR Functions
  */
@@ -2481,15 +4041,294 @@ boolean CheckForMPUClock() {
 }
 #endif
  
+/******************************************************
+ *   Switch Strobe Timer
+ */
+// Timer2 paces the switch strobes so the interrupt handlers don't have to 
+// sit in delayMicroseconds() while the switch lines settle.
+// With the 1/32 prescaler each count is 2 us (longest step is 512 us).
+// The OS owns Timer2 on these boards, so tone() and PWM (analogWrite) on 
+// pins 9 and 10 can't be used.
+#define RPU_SWITCH_STROBE_TIMER_COUNT(us)   ((byte)(((us)/2)-1))
+
+void StartSwitchStrobeTimer(byte timerCount) {
+  TCCR2B = 0;
+  // CTC mode
+  TCCR2A = (1<<WGM21);
+  TCNT2 = 0;
+  OCR2A = timerCount;
+  // Clear any stale compare match and enable the interrupt
+  TIFR2 = (1<<OCF2A);
+  TIMSK2 |= (1<<OCIE2A);
+  // Set the prescale 1/32 clock
+  TCCR2B = (1<<CS21) | (1<<CS20);
+}
+
+void RestartSwitchStrobeTimer(byte timerCount) {
+  // Time the next step from now, in case this handler was held off,
+  // and drop a match that came during this step so the gap is kept
+  TCNT2 = 0;
+  OCR2A = timerCount;
+  TIFR2 = (1<<OCF2A);
+}
+
+void StopSwitchStrobeTimer() {
+  TCCR2B = 0;
+  TIMSK2 &= ~(1<<OCIE2A);
+}
+
+
+/******************************************************
+ *   Interrupt Timing
+ */
+// Each interrupt handler (or Timer2 step) is a chunk of work with 
+// interrupts off, so the longest chunk is the worst the display 
+// interrupt can be held off. Chunks over the budget are counted.
+#ifndef RPU_OS_INTERRUPT_CHUNK_BUDGET_IN_MICROSECONDS
+#define RPU_OS_INTERRUPT_CHUNK_BUDGET_IN_MICROSECONDS   150
+#endif
+#if (RPU_MPU_ARCHITECTURE<10)
+// Timer1 counts at 64us (1/1024 prescaler at 16 MHz)
+#define DISPLAY_TIMER_COUNTS_TO_MICROSECONDS(counts)  ((counts)*64)
+#else
+// Timer1 counts at 1/16 us (no prescaler)
+#define DISPLAY_TIMER_COUNTS_TO_MICROSECONDS(counts)  ((counts)/16)
+#endif
+volatile unsigned int InterruptChunkMaxTime = 0;
+volatile unsigned long InterruptChunkOverruns = 0;
+volatile unsigned int DisplayInterruptMaxLatency = 0;
+
+void RecordInterruptChunk(unsigned long chunkStart) {
+  unsigned int chunkTime = (unsigned int)(micros() - chunkStart);
+  if (chunkTime>InterruptChunkMaxTime) InterruptChunkMaxTime = chunkTime;
+  if (chunkTime>RPU_OS_INTERRUPT_CHUNK_BUDGET_IN_MICROSECONDS) InterruptChunkOverruns += 1;
+}
+
+// Called at the top of the display interrupt - Timer1 has been
+// counting since the compare match, so TCNT1 is how late we are
+void RecordDisplayInterruptLatency() {
+  unsigned int latency = DISPLAY_TIMER_COUNTS_TO_MICROSECONDS(TCNT1);
+  if (latency>DisplayInterruptMaxLatency) DisplayInterruptMaxLatency = latency;
+}
+
+unsigned int RPU_GetInterruptChunkMaxTime() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int chunkTime = InterruptChunkMaxTime;
+  SREG = oldSREG;
+  return chunkTime;
+}
+
+unsigned long RPU_GetInterruptChunkOverruns() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned long overruns = InterruptChunkOverruns;
+  SREG = oldSREG;
+  return overruns;
+}
+
+unsigned int RPU_GetDisplayInterruptMaxLatency() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int latency = DisplayInterruptMaxLatency;
+  SREG = oldSREG;
+  return latency;
+}
+
+unsigned int RPU_GetInterruptChunkBudget() {
+  return RPU_OS_INTERRUPT_CHUNK_BUDGET_IN_MICROSECONDS;
+}
+
+void RPU_ResetInterruptTiming() {
+  byte oldSREG = SREG;
+  cli();
+  InterruptChunkMaxTime = 0;
+  InterruptChunkOverruns = 0;
+  DisplayInterruptMaxLatency = 0;
+  SREG = oldSREG;
+}
+
+
+#if (RPU_MPU_ARCHITECTURE<10)
+/******************************************************
+ *   Zero-Crossing Monitor
+ */
+// The zero-crossing handler paces the switch scan and the lamp strobe,
+// so its timing is watched here. Timer5 runs free at 4us per count and
+// is read as soon as InterruptService3 starts. The interrupt is level
+// sensitive, so a noisy edge can bring it back right away - a crossing
+// less than half a period after the last one is cleared without 
+// starting another scan.
+#ifdef TCCR5A
+#define ZERO_CROSSING_TIMER_NOW()   TCNT5
+#else
+// No Timer5 on the Nano boards, so micros() stands in
+#define ZERO_CROSSING_TIMER_NOW()   ((unsigned int)(micros()>>2))
+#endif
+#define ZERO_CROSSING_TIMER_COUNTS_TO_MICROSECONDS(counts)  ((counts)*4)
+// Timer counts between crossings (two per mains cycle)
+#define ZERO_CROSSING_PERIOD_50HZ   2500
+#define ZERO_CROSSING_PERIOD_60HZ   2083
+// Timer5 wraps after 262ms, so longer gaps are timed with micros()
+#define ZERO_CROSSING_LONG_GAP_IN_MICROSECONDS  200000
+volatile unsigned int ZeroCrossingLastTime = 0;
+volatile unsigned long ZeroCrossingLastMicros = 0;
+volatile unsigned int ZeroCrossingAveragePeriod = 0;  // 1/16 weight
+volatile unsigned int ZeroCrossingMaxJitter = 0;      // furthest from the average
+volatile unsigned long ZeroCrossingCount = 0;
+volatile unsigned long ZeroCrossingRetriggers = 0;
+volatile unsigned long ZeroCrossingMissed = 0;
+
+void StartZeroCrossingTimer() {
+#ifdef TCCR5A
+  TCCR5A = 0;
+  TCCR5B = (1<<CS51) | (1<<CS50);   // normal mode, 1/64 prescaler
+  TIMSK5 = 0;
+#endif
+}
+
+// Mains is assumed to be 60 Hz until the crossings say otherwise
+unsigned int ZeroCrossingNominalPeriod() {
+  if (ZeroCrossingAveragePeriod>((ZERO_CROSSING_PERIOD_50HZ+ZERO_CROSSING_PERIOD_60HZ)/2)) return ZERO_CROSSING_PERIOD_50HZ;
+  return ZERO_CROSSING_PERIOD_60HZ;
+}
+
+// Returns false for a retrigger, which shouldn't start a scan
+boolean RecordZeroCrossing(unsigned int crossingTime, unsigned long crossingMicros) {
+  unsigned int nominalPeriod = ZeroCrossingNominalPeriod();
+  unsigned long period = (unsigned int)(crossingTime - ZeroCrossingLastTime);
+  if ((crossingMicros - ZeroCrossingLastMicros)>ZERO_CROSSING_LONG_GAP_IN_MICROSECONDS) period = (crossingMicros - ZeroCrossingLastMicros)/4;
+
+  if (ZeroCrossingCount!=0) {
+    if (period<(nominalPeriod/2)) {
+      ZeroCrossingRetriggers += 1;
+      return false;
+    }
+    if (period>(nominalPeriod + nominalPeriod/2)) {
+      ZeroCrossingMissed += (period + nominalPeriod/2)/nominalPeriod - 1;
+    } else if (ZeroCrossingAveragePeriod==0) {
+      ZeroCrossingAveragePeriod = period;
+    } else {
+      unsigned int jitter = (period>ZeroCrossingAveragePeriod) ? (period - ZeroCrossingAveragePeriod) : (ZeroCrossingAveragePeriod - period);
+      if (jitter>ZeroCrossingMaxJitter) ZeroCrossingMaxJitter = jitter;
+      ZeroCrossingAveragePeriod = (long)ZeroCrossingAveragePeriod + ((long)period - (long)ZeroCrossingAveragePeriod)/16;
+    }
+  }
+
+  ZeroCrossingLastTime = crossingTime;
+  ZeroCrossingLastMicros = crossingMicros;
+  ZeroCrossingCount += 1;
+  return true;
+}
+
+// Mains frequency in tenths of a Hz (0 until a period has been timed)
+unsigned int RPU_GetZeroCrossingFrequency() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int averagePeriod = ZeroCrossingAveragePeriod;
+  SREG = oldSREG;
+  if (averagePeriod==0) return 0;
+  return (unsigned int)(5000000UL/ZERO_CROSSING_TIMER_COUNTS_TO_MICROSECONDS((unsigned long)averagePeriod));
+}
+
+unsigned int RPU_GetZeroCrossingPeriod() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int averagePeriod = ZeroCrossingAveragePeriod;
+  SREG = oldSREG;
+  return ZERO_CROSSING_TIMER_COUNTS_TO_MICROSECONDS(averagePeriod);
+}
+
+unsigned int RPU_GetZeroCrossingMaxJitter() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int jitter = ZeroCrossingMaxJitter;
+  SREG = oldSREG;
+  return ZERO_CROSSING_TIMER_COUNTS_TO_MICROSECONDS(jitter);
+}
+
+unsigned long RPU_GetZeroCrossingCount() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned long crossings = ZeroCrossingCount;
+  SREG = oldSREG;
+  return crossings;
+}
+
+unsigned long RPU_GetZeroCrossingRetriggers() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned long retriggers = ZeroCrossingRetriggers;
+  SREG = oldSREG;
+  return retriggers;
+}
+
+unsigned long RPU_GetZeroCrossingMissed() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned long missed = ZeroCrossingMissed;
+  SREG = oldSREG;
+  return missed;
+}
+
+// True when nothing else should need the bus for the next few hundred
+// microseconds: no zero-crossing sequence is in flight, and neither the
+// display interrupt nor the next zero crossing is due in that time. A
+// crossing that's overdue can't be predicted, so it isn't waited for.
+boolean BusQuietFor(unsigned int microseconds) {
+  if (InsideZeroCrossingInterrupt) return false;
+  if (DISPLAY_TIMER_COUNTS_TO_MICROSECONDS((unsigned long)(OCR1A - TCNT1))<microseconds) return false;
+  if (ZeroCrossingCount!=0) {
+    unsigned long sinceCrossing = micros() - ZeroCrossingLastMicros;
+    unsigned long period = ZERO_CROSSING_TIMER_COUNTS_TO_MICROSECONDS((unsigned long)ZeroCrossingNominalPeriod());
+    if (sinceCrossing<period && (period - sinceCrossing)<microseconds) return false;
+  }
+  return true;
+}
+
+void RPU_ResetZeroCrossingStats() {
+  byte oldSREG = SREG;
+  cli();
+  ZeroCrossingAveragePeriod = 0;
+  ZeroCrossingMaxJitter = 0;
+  ZeroCrossingCount = 0;
+  ZeroCrossingRetriggers = 0;
+  ZeroCrossingMissed = 0;
+  SREG = oldSREG;
+}
+#endif
+
+
 #if (RPU_MPU_ARCHITECTURE<10)
 
 volatile int numberOfU10Interrupts = 0;
 volatile int numberOfU11Interrupts = 0;
-volatile byte InsideZeroCrossingInterrupt = 0;
+
+// The zero-crossing switch scan is a small state machine paced by
+// Timer2 instead of delayMicroseconds(). Each compare match does one
+// strobe step (read a column, or strobe the next one) and returns, so
+// the processor is free while the switch capacitors charge.
+// After the switches it carries on through the lamps, one bank per
+// step, so the display interrupt never waits for more than one chunk.
+#define SWITCH_STROBE_IDLE        0
+#define SWITCH_STROBE_SETTLING    1
+#define SWITCH_STROBE_PADDING     2
+#define SWITCH_STROBE_LAMPS       3
+#ifndef RPU_OS_LAMP_CHUNK_GAP_IN_MICROSECONDS
+#define RPU_OS_LAMP_CHUNK_GAP_IN_MICROSECONDS   8
+#endif
+volatile byte SwitchStrobeState = SWITCH_STROBE_IDLE;
+volatile byte SwitchStrobeColumn = 0;
+volatile byte LampStrobeStep = 0;
+byte ZeroCrossingBackupU10A;
+byte ZeroCrossingU10BControl;
 
 // INTERRUPT SERVICE ROUTINE
 // for ARCH 1 (B/S)
 ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
+  unsigned long chunkStart = micros();
+  RecordDisplayInterruptLatency();
+
   // Backup U10A
   byte backupU10A = RPU_DataRead(ADDRESS_U10_A);
   
@@ -2523,7 +4362,7 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
 
     // The BCD for this digit is in b4-b7, and the display latch strobes are in b0-b3 (and U11A:b0)
     byte displayDataByte = ((DisplayDigits[displayCount][CurrentDisplayDigit])<<4) | 0x0F;
-    byte displayEnable = ((DisplayDigitEnable[displayCount])>>CurrentDisplayDigit)&0x01;
+    byte displayEnable = ((DisplayDigitEnable[displayCount] & DisplayAnimations[displayCount].blinkGate)>>CurrentDisplayDigit)&0x01;
 
     // if this digit shouldn't be displayed, then set data lines to 0xFX so digit will be blank
     if (!displayEnable) displayDataByte = 0xFF;
@@ -2548,7 +4387,7 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
     // Right now the "Display Latch Strobe" is high
 
     // Put the latch strobe bits back high (low on the port)
-    delayMicroseconds(16);
+    delayMicroseconds(DisplayLatchDelay);
     if (displayCount<4) {
       displayDataByte |= 0x0F;
       // Need to delay a little to make sure the strobe is low (high on the port) for long enough
@@ -2575,6 +4414,13 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
   // Restore 10A from backup
   RPU_DataWrite(ADDRESS_U10_A, backupU10A);    
 
+  UpdateDisplayAnimations();
+
+  // If we interrupted a switch strobe, the returns were disturbed 
+  // by the display data, so give the column its full settling time again
+  if (SwitchStrobeState==SWITCH_STROBE_SETTLING) TCNT2 = 0;
+
+  RecordInterruptChunk(chunkStart);
 }
 
 /*
@@ -2604,7 +4450,7 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
     if (CurrentDisplayDigit<RPU_OS_NUM_DIGITS) {
       // The BCD for this digit is in b4-b7, and the display latch strobes are in b0-b3 (and U11A:b0)
       byte displayDataByte = ((DisplayDigits[displayCount][CurrentDisplayDigit])<<4) | 0x0F;
-      byte displayEnable = ((DisplayDigitEnable[displayCount])>>CurrentDisplayDigit)&0x01;
+      byte displayEnable = ((DisplayDigitEnable[displayCount] & DisplayAnimations[displayCount].blinkGate)>>CurrentDisplayDigit)&0x01;
 
       // if this digit shouldn't be displayed, then set data lines to 0xFX so digit will be blank
       if (!displayEnable) displayDataByte = 0xFF;
@@ -2657,288 +4503,352 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request
 */
 
 
-void InterruptService3() {
-  byte u10AControl = RPU_DataRead(ADDRESS_U10_A_CONTROL);
-  if (u10AControl & 0x80) {
-    // self test switch
-    if (RPU_DataRead(ADDRESS_U10_A_CONTROL) & 0x80) PushToSwitchStack(SW_SELF_TEST_SWITCH);
-    RPU_DataRead(ADDRESS_U10_A);
-  }
-
-  // If we get a weird interupt from U11B, clear it
-  byte u11BControl = RPU_DataRead(ADDRESS_U11_B_CONTROL);
-  if (u11BControl & 0x80) {
-    RPU_DataRead(ADDRESS_U11_B);    
-  }
-
-  byte u11AControl = RPU_DataRead(ADDRESS_U11_A_CONTROL);
-  byte u10BControl = RPU_DataRead(ADDRESS_U10_B_CONTROL);
-
-  // If the interrupt bit on the display interrupt is on, do the display refresh
-  if (u11AControl & 0x80) {
-    RPU_DataRead(ADDRESS_U11_A);
-    numberOfU11Interrupts+=1;
-  }
-
-  // If the IRQ bit of U10BControl is set, do the Zero-crossing interrupt handler
-  if ((u10BControl & 0x80) && (InsideZeroCrossingInterrupt==0)) {
-    InsideZeroCrossingInterrupt = InsideZeroCrossingInterrupt + 1;
-
-    byte u10BControlLatest = RPU_DataRead(ADDRESS_U10_B_CONTROL);
-
-    // Backup contents of U10A
-    byte backup10A = RPU_DataRead(ADDRESS_U10_A);
-
-    // Latch 0xFF separately without interrupt clear
-    RPU_DataWrite(ADDRESS_U10_A, 0xFF);
-    RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) | 0x08);
-    RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) & 0xF7);
-    // Read U10B to clear interrupt
-    RPU_DataRead(ADDRESS_U10_B);
-
-    // Turn off U10BControl interrupts
-    RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x30);
-
-    // Copy old switch values
-    byte switchCount;
-    byte startingClosures;
-    byte validClosures;
-    for (switchCount=0; switchCount<NUM_SWITCH_BYTES; switchCount++) {
-      SwitchesMinus2[switchCount] = SwitchesMinus1[switchCount];
-      SwitchesMinus1[switchCount] = SwitchesNow[switchCount];
-
-      // Enable switch strobe
+void StrobeSwitchColumn(byte switchCount) {
+  // Enable switch strobe
 #if defined(RPU_USE_EXTENDED_SWITCHES_ON_PB4) or defined(RPU_USE_EXTENDED_SWITCHES_ON_PB7)
-      if (switchCount<NUM_SWITCH_BYTES_ON_U10_PORT_A) {
-        RPU_DataWrite(ADDRESS_U10_A, 0x01<<switchCount);
-      } else {
-        RPU_SetContinuousSolenoidBit(true, ST5_CONTINUOUS_SOLENOID_BIT);
-      }
+  if (switchCount<NUM_SWITCH_BYTES_ON_U10_PORT_A) {
+    RPU_DataWrite(ADDRESS_U10_A, 0x01<<switchCount);
+  } else {
+    RPU_SetContinuousSolenoidBit(true, ST5_CONTINUOUS_SOLENOID_BIT);
+  }
 #else       
-      RPU_DataWrite(ADDRESS_U10_A, 0x01<<switchCount);
+  RPU_DataWrite(ADDRESS_U10_A, 0x01<<switchCount);
 #endif        
 
-      // Turn off U10:CB2 if it's on (because it strobes the last bank of dip switches
-      RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x34);
+  // Turn off U10:CB2 if it's on (because it strobes the last bank of dip switches
+  RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x34);
+}
 
-      // Delay for switch capacitors to charge
-      delayMicroseconds(RPU_OS_SWITCH_DELAY_IN_MICROSECONDS);
-      
-      // Read the switches
-      SwitchesNow[switchCount] = RPU_DataRead(ADDRESS_U10_B);
 
-      //Unset the strobe
-      RPU_DataWrite(ADDRESS_U10_A, 0x00);
+void ReadSwitchColumn(byte switchCount) {
+  // Read the switches
+  SwitchesNow[switchCount] = RPU_DataRead(ADDRESS_U10_B);
+
+  //Unset the strobe
+  RPU_DataWrite(ADDRESS_U10_A, 0x00);
 #if defined(RPU_USE_EXTENDED_SWITCHES_ON_PB4) or defined(RPU_USE_EXTENDED_SWITCHES_ON_PB7)
-      RPU_SetContinuousSolenoidBit(false, ST5_CONTINUOUS_SOLENOID_BIT);
+  RPU_SetContinuousSolenoidBit(false, ST5_CONTINUOUS_SOLENOID_BIT);
 #endif 
 
-      // Some switches need to trigger immediate closures (bumpers & slings)
-      startingClosures = (SwitchesNow[switchCount]) & (~SwitchesMinus1[switchCount]);
-      boolean immediateSolenoidFired = false;
-      // If one of the switches is starting to close (off, on)
-      if (startingClosures) {
-        // Loop on bits of switch byte
-        for (byte bitCount=0; bitCount<8 && immediateSolenoidFired==false; bitCount++) {
-          // If this switch bit is closed
-          if (startingClosures&0x01) {
-            byte startingSwitchNum = switchCount*8 + bitCount;
-            // Loop on immediate switch data
-            for (int immediateSwitchCount=0; immediateSwitchCount<NumGamePrioritySwitches && immediateSolenoidFired==false; immediateSwitchCount++) {
-              // If this switch requires immediate action
-              if (GameSwitches && startingSwitchNum==GameSwitches[immediateSwitchCount].switchNum) {
-                // Start firing this solenoid (just one until the closure is validate
-                PushToFrontOfSolenoidStack(GameSwitches[immediateSwitchCount].solenoid, 1);
-                immediateSolenoidFired = true;
-              }
-            }
+  // Some switches need to trigger immediate closures (bumpers & slings)
+  byte startingClosures;
+  byte validClosures = DebounceSwitchByte(switchCount, &startingClosures);
+  boolean immediateSolenoidFired = false;
+  // If one of the switches is starting to close (off, on)
+  if (startingClosures) {
+    // Loop on bits of switch byte
+    for (byte bitCount=0; bitCount<8 && immediateSolenoidFired==false; bitCount++) {
+      // If this switch bit is closed
+      if (startingClosures&0x01) {
+        byte startingSwitchNum = switchCount*8 + bitCount;
+        // Loop on immediate switch data
+        for (int immediateSwitchCount=0; immediateSwitchCount<NumGamePrioritySwitches && immediateSolenoidFired==false; immediateSwitchCount++) {
+          // If this switch requires immediate action
+          if (GameSwitches && startingSwitchNum==GameSwitches[immediateSwitchCount].switchNum) {
+            // Start firing this solenoid (just one until the closure is validate
+            PushToFrontOfSolenoidStack(GameSwitches[immediateSwitchCount].solenoid, 1);
+            immediateSolenoidFired = true;
           }
-          startingClosures = startingClosures>>1;
         }
       }
+      startingClosures = startingClosures>>1;
+    }
+  }
 
-      immediateSolenoidFired = false;
-      validClosures = (SwitchesNow[switchCount] & SwitchesMinus1[switchCount]) & ~SwitchesMinus2[switchCount];
-      // If there is a valid switch closure (off, on, on)
-      if (validClosures) {
-        // Loop on bits of switch byte
-        for (byte bitCount=0; bitCount<8; bitCount++) {
-          // If this switch bit is closed
-          if (validClosures&0x01) {
-            byte validSwitchNum = switchCount*8 + bitCount;
-            // Loop through all switches and see what's triggered
-            for (int validSwitchCount=0; validSwitchCount<NumGameSwitches; validSwitchCount++) {
-
-              // If we've found a valid closed switch
-              if (GameSwitches && GameSwitches[validSwitchCount].switchNum==validSwitchNum) {
-
-                // If we're supposed to trigger a solenoid, then do it
-                if (GameSwitches[validSwitchCount].solenoid!=SOL_NONE) {
-                  if (validSwitchCount<NumGamePrioritySwitches && immediateSolenoidFired==false) {
-                    PushToFrontOfSolenoidStack(GameSwitches[validSwitchCount].solenoid, GameSwitches[validSwitchCount].solenoidHoldTime);
-                  } else {
-                    RPU_PushToSolenoidStack(GameSwitches[validSwitchCount].solenoid, GameSwitches[validSwitchCount].solenoidHoldTime);
-                  }
-                } // End if this is a real solenoid
-              } // End if this is a switch in the switch table
-            } // End loop on switches in switch table
-            // Push this switch to the game rules stack
-            PushToSwitchStack(validSwitchNum);
-          }
-          validClosures = validClosures>>1;
-        }        
+  immediateSolenoidFired = false;
+  // If there is a valid switch closure (off, then on for the debounce length)
+  if (validClosures) {
+    // Loop on bits of switch byte
+    for (byte bitCount=0; bitCount<8; bitCount++) {
+      // If this switch bit is closed
+      if (validClosures&0x01) {
+        byte validSwitchNum = switchCount*8 + bitCount;
+        // Loop through all switches and see what's triggered
+        for (int validSwitchCount=0; validSwitchCount<NumGameSwitches; validSwitchCount++) {
+
+          // If we've found a valid closed switch
+          if (GameSwitches && GameSwitches[validSwitchCount].switchNum==validSwitchNum) {
+
+            // If we're supposed to trigger a solenoid, then do it
+            if (GameSwitches[validSwitchCount].solenoid!=SOL_NONE) {
+              if (validSwitchCount<NumGamePrioritySwitches && immediateSolenoidFired==false) {
+                PushToFrontOfSolenoidStack(GameSwitches[validSwitchCount].solenoid, GameSwitches[validSwitchCount].solenoidHoldTime);
+              } else {
+                RPU_PushToSolenoidStack(GameSwitches[validSwitchCount].solenoid, GameSwitches[validSwitchCount].solenoidHoldTime);
+              }
+            } // End if this is a real solenoid
+          } // End if this is a switch in the switch table
+        } // End loop on switches in switch table
+        // Push this switch to the game rules stack
+        PushToSwitchStack(validSwitchNum);
       }
+      validClosures = validClosures>>1;
+    }        
+  }
+}
 
-      // There are no port reads or writes for the rest of the loop, 
-      // so we can allow the display interrupt to fire
-      interrupts();
-      
-      // Wait so total delay will allow lamp SCRs to get to the proper voltage
-      delayMicroseconds(RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS);
-      
-      noInterrupts();
-    }
-    RPU_DataWrite(ADDRESS_U10_A, backup10A);
 
-    if (NumCyclesBeforeRevertingSolenoidByte!=0) {
-      NumCyclesBeforeRevertingSolenoidByte -= 1;
-      if (NumCyclesBeforeRevertingSolenoidByte==0) {
-        CurrentSolenoidByte |= RevertSolenoidBit;
-        RevertSolenoidBit = 0x00;
-      }
+// Called from the strobe state machine after the last switch column
+// has been read. This is the first chunk of the rest of the zero-crossing 
+// work - the lamps follow one bank per Timer2 step (see StrobeLampStep).
+void UpdateSolenoids() {
+  RPU_DataWrite(ADDRESS_U10_A, ZeroCrossingBackupU10A);
+
+  if (NumCyclesBeforeRevertingSolenoidByte!=0) {
+    NumCyclesBeforeRevertingSolenoidByte -= 1;
+    if (NumCyclesBeforeRevertingSolenoidByte==0) {
+      CurrentSolenoidByte |= RevertSolenoidBit;
+      RevertSolenoidBit = 0x00;
     }
+  }
 
 #ifdef RPU_OS_USE_DASH32
-    // mask out sound E line
-    byte curDisplayDigitEnableByte = RPU_DataRead(ADDRESS_U11_A);
-    RPU_DataWrite(ADDRESS_U11_A, curDisplayDigitEnableByte | 0x02);
+  // mask out sound E line
+  byte curDisplayDigitEnableByte = RPU_DataRead(ADDRESS_U11_A);
+  RPU_DataWrite(ADDRESS_U11_A, curDisplayDigitEnableByte | 0x02);
 #endif    
 
-    // If we need to turn off momentary solenoids, do it first
-    byte momentarySolenoidAtStart = PullFirstFromSolenoidStack();
-    if (momentarySolenoidAtStart!=SOLENOID_STACK_EMPTY) {
-      CurrentSolenoidByte = (CurrentSolenoidByte&0xF0) | momentarySolenoidAtStart;
-      RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  // If we need to turn off momentary solenoids, do it first
+  // (if a sound byte is on U11B, the sound restore writes it)
+  byte momentarySolenoidAtStart = PullFirstFromSolenoidStack();
+  if (momentarySolenoidAtStart!=SOLENOID_STACK_EMPTY) {
+    CurrentSolenoidByte = (CurrentSolenoidByte&0xF0) | momentarySolenoidAtStart;
+    if (!SoundTransferActive) RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
 #ifdef RPU_OS_USE_DASH32
-      // Raise CB2 so we don't unset the solenoid we just set
-      RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x3C);
-      // Mask off sound lines
-      RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte | SOL_NONE);
-      // Put CB2 back low
-      RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
-      // Put solenoids back again
-      RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+    // Raise CB2 so we don't unset the solenoid we just set
+    RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x3C);
+    // Mask off sound lines
+    RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte | SOL_NONE);
+    // Put CB2 back low
+    RPU_DataWrite(ADDRESS_U11_B_CONTROL, 0x34);
+    // Put solenoids back again
+    RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
 #endif    
-    } else {
-      CurrentSolenoidByte = (CurrentSolenoidByte&0xF0) | SOL_NONE;
-      RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
-    }
+  } else {
+    CurrentSolenoidByte = (CurrentSolenoidByte&0xF0) | SOL_NONE;
+    if (!SoundTransferActive) RPU_DataWrite(ADDRESS_U11_B, CurrentSolenoidByte);
+  }
 
 #ifdef RPU_OS_USE_DASH32
-    // put back U11 A without E line
-    RPU_DataWrite(ADDRESS_U11_A, curDisplayDigitEnableByte);
+  // put back U11 A without E line
+  RPU_DataWrite(ADDRESS_U11_A, curDisplayDigitEnableByte);
 #endif    
 
-    for (int lampByteCount=0; lampByteCount<8; lampByteCount++) {
-      for (byte nibbleCount=0; nibbleCount<2; nibbleCount++) {
-        
-        // We skip iteration number 16 because the last position is to park the lamps
-        if (lampByteCount==(7) && nibbleCount) continue;
-        
-        byte lampData = 0xF0 + (lampByteCount*2) + nibbleCount;
-
-        interrupts();
-        RPU_DataWrite(ADDRESS_U10_A, 0xFF);
-        noInterrupts();
-
-        // Latch address & strobe
-        RPU_DataWrite(ADDRESS_U10_A, lampData);
-#ifdef RPU_SLOW_DOWN_LAMP_STROBE      
-        delayMicroseconds(2);
-#endif      
-
-        RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x38);
-#ifdef RPU_SLOW_DOWN_LAMP_STROBE      
-        delayMicroseconds(2);
-#endif      
-
-        RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x30);
-#ifdef RPU_SLOW_DOWN_LAMP_STROBE      
-        delayMicroseconds(2);
-#endif      
-
-        // Use the inhibit lines to set the actual data to the lamp SCRs 
-        // (here, we don't care about the lower nibble because the address was already latched)
-        byte nibbleOffset = (nibbleCount)?1:16;
-        byte lampOutput = (LampStates[lampByteCount] * nibbleOffset);
-        // Every other time through the cycle, we OR in the dim variable
-        // in order to dim those lights
-        if (numberOfU10Interrupts%DimDivisor1) lampOutput |= (LampDim1[lampByteCount] * nibbleOffset);
-        if (numberOfU10Interrupts%DimDivisor2) lampOutput |= (LampDim2[lampByteCount] * nibbleOffset);
-
-        RPU_DataWrite(ADDRESS_U10_A, lampOutput | 0x0F);
-#ifdef RPU_SLOW_DOWN_LAMP_STROBE      
-        delayMicroseconds(2);
-#endif      
-      } // end loop on nibble
-    } // end loop on lamp bytes
+  // Lamp data goes out with the latch off between chunks
+  RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+}
+
+
+volatile byte *FrontLampStates = LampStateBuffers[0];
+
+// Strobes both nibbles of one lamp bank (bank 7 only has the lower nibble)
+void StrobeLampBank(byte lampByteCount) {
+  for (byte nibbleCount=0; nibbleCount<2; nibbleCount++) {
+      
+    // We skip iteration number 16 because the last position is to park the lamps
+    if (lampByteCount==(7) && nibbleCount) continue;
+      
+    byte lampData = 0xF0 + (lampByteCount*2) + nibbleCount;
+
+    RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+
+    // Latch address & strobe
+    RPU_DataWrite(ADDRESS_U10_A, lampData);
+    if (LampStrobePadding) delayMicroseconds(LampStrobePadding);
+
+    RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x38);
+    if (LampStrobePadding) delayMicroseconds(LampStrobePadding);
+
+    RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x30);
+    if (LampStrobePadding) delayMicroseconds(LampStrobePadding);
+
+    // Use the inhibit lines to set the actual data to the lamp SCRs 
+    // (here, we don't care about the lower nibble because the address was already latched)
+    byte nibbleOffset = (nibbleCount)?1:16;
+    byte lampOutput = (FrontLampStates[lampByteCount] * nibbleOffset);
+    // Every other time through the cycle, we OR in the dim variable
+    // in order to dim those lights
+    if (numberOfU10Interrupts%DimDivisor1) lampOutput |= (LampDim1[lampByteCount] * nibbleOffset);
+    if (numberOfU10Interrupts%DimDivisor2) lampOutput |= (LampDim2[lampByteCount] * nibbleOffset);
+
+    RPU_DataWrite(ADDRESS_U10_A, lampOutput | 0x0F);
+    if (LampStrobePadding) delayMicroseconds(LampStrobePadding);
+  } // end loop on nibble
+  RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+}
 
 
 #ifdef RPU_OS_USE_AUX_LAMPS
+// For the first four bits of aux lamps, we look at lamp bank 7 again
+// and use those top 4 bits that we didn't use before. Then we move on 
+// with bytes 8, 9, and 10 for the remaining 24 bits of data
+void StrobeAuxLampBank(byte lampByteCount) {
+  if (lampByteCount==7) {
     // Latch 0xFF separately without interrupt clear
     // to park 0xFF in main lamp board
     RPU_DataWrite(ADDRESS_U10_A, 0xFF);
     RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) | 0x08);
     RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) & 0xF7);
+  }
 
-    // For the first four bits of lamps, we're going to look at LampStates[7] again
-    // and use those top 4 bits that we didn't use before. Then we're going
-    // to move on with bytes 8, 9, and 10 for the remaining 24 bits of data
-    byte auxBankNum = 0;
-    for (int lampByteCount=7; lampByteCount<RPU_NUM_LAMP_BANKS; lampByteCount++) {
-      for (byte nibbleCount=0; nibbleCount<2; nibbleCount++) {
-        if (lampByteCount==7) nibbleCount = 1; // skip the first nibble of byte 7 because it belongs to primary lamps
-        byte nibbleOffset = (nibbleCount)?1:16;
-        byte lampOutput = (LampStates[lampByteCount] * nibbleOffset);
-        // Every other time through the cycle, we OR in the dim variable
-        // in order to dim those lights
-        if (numberOfU10Interrupts%DimDivisor1) lampOutput |= (LampDim1[lampByteCount] * nibbleOffset);
-        if (numberOfU10Interrupts%DimDivisor2) lampOutput |= (LampDim2[lampByteCount] * nibbleOffset);
-
-        // The data will be in the upper nibble, but we need the bank count in the lower
-        lampOutput &= 0xF0;
-        lampOutput += auxBankNum;
-
-        interrupts();
-        RPU_DataWrite(ADDRESS_U10_A, 0xFF);
-        noInterrupts();
-
-        RPU_DataWrite(ADDRESS_U10_A, lampOutput | 0xF0);
-        RPU_DataWrite(ADDRESS_U11_A_CONTROL, RPU_DataRead(ADDRESS_U11_A_CONTROL) | 0x08);
-        RPU_DataWrite(ADDRESS_U11_A_CONTROL, RPU_DataRead(ADDRESS_U11_A_CONTROL) & 0xF7);    
-        RPU_DataWrite(ADDRESS_U10_A, lampOutput);
-        
-        auxBankNum += 1;
-      }
-    }
+  for (byte nibbleCount=0; nibbleCount<2; nibbleCount++) {
+    if (lampByteCount==7) nibbleCount = 1; // skip the first nibble of byte 7 because it belongs to primary lamps
+    byte auxBankNum = (lampByteCount-7)*2 + nibbleCount - 1;
+    byte nibbleOffset = (nibbleCount)?1:16;
+    byte lampOutput = (FrontLampStates[lampByteCount] * nibbleOffset);
+    // Every other time through the cycle, we OR in the dim variable
+    // in order to dim those lights
+    if (numberOfU10Interrupts%DimDivisor1) lampOutput |= (LampDim1[lampByteCount] * nibbleOffset);
+    if (numberOfU10Interrupts%DimDivisor2) lampOutput |= (LampDim2[lampByteCount] * nibbleOffset);
+
+    // The data will be in the upper nibble, but we need the bank count in the lower
+    lampOutput &= 0xF0;
+    lampOutput += auxBankNum;
+
+    RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+
+    RPU_DataWrite(ADDRESS_U10_A, lampOutput | 0xF0);
+    RPU_DataWrite(ADDRESS_U11_A_CONTROL, RPU_DataRead(ADDRESS_U11_A_CONTROL) | 0x08);
+    RPU_DataWrite(ADDRESS_U11_A_CONTROL, RPU_DataRead(ADDRESS_U11_A_CONTROL) & 0xF7);    
+    RPU_DataWrite(ADDRESS_U10_A, lampOutput);
+  }
+  RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+}
 #endif    
 
+
+// Parks the lamps and hands the PIAs back - the end of the zero-crossing work
+void FinishZeroCrossing() {
+  // Latch 0xFF separately without interrupt clear
+  RPU_DataWrite(ADDRESS_U10_A, 0xFF);
+  RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) | 0x08);
+  RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) & 0xF7);
+
+  InsideZeroCrossingInterrupt = 0;
+  RPU_DataWrite(ADDRESS_U10_A, ZeroCrossingBackupU10A);
+  RPU_DataWrite(ADDRESS_U10_B_CONTROL, ZeroCrossingU10BControl);
+
+  // Read U10B to clear interrupt
+  RPU_DataRead(ADDRESS_U10_B);
+  numberOfU10Interrupts+=1;
+}
+
+
+// One lamp chunk per Timer2 step: banks 0-7, then the aux banks, then the finish.
+// Returns true when the zero-crossing work is done.
+boolean StrobeLampStep(byte lampStep) {
+  if (lampStep==0) FrontLampStates = StartLampPass();
+  if (lampStep<8) {
+    StrobeLampBank(lampStep);
+    return false;
+  }
+#ifdef RPU_OS_USE_AUX_LAMPS
+  if (lampStep<=RPU_NUM_LAMP_BANKS) {
+    StrobeAuxLampBank(lampStep-1);
+    return false;
+  }
+#endif
+  FinishZeroCrossing();
+  return true;
+}
+
+
+// INTERRUPT SERVICE ROUTINE
+// for the switch strobe state machine (Timer2)
+ISR(TIMER2_COMPA_vect) {
+  unsigned long chunkStart = micros();
+  if (SwitchStrobeState==SWITCH_STROBE_SETTLING) {
+    // Capacitors have charged, so read this column and 
+    // wait so total delay will allow lamp SCRs to get to the proper voltage
+    ReadSwitchColumn(SwitchStrobeColumn);
+    SwitchStrobeState = SWITCH_STROBE_PADDING;
+    RestartSwitchStrobeTimer(RPU_SWITCH_STROBE_TIMER_COUNT(RPU_OS_TIMING_LOOP_PADDING_IN_MICROSECONDS));
+  } else if (SwitchStrobeState==SWITCH_STROBE_PADDING) {
+    SwitchStrobeColumn += 1;
+    if (SwitchStrobeColumn<NUM_SWITCH_BYTES) {
+      StrobeSwitchColumn(SwitchStrobeColumn);
+      SwitchStrobeState = SWITCH_STROBE_SETTLING;
+      RestartSwitchStrobeTimer(RPU_SWITCH_STROBE_TIMER_COUNT(RPU_OS_SWITCH_DELAY_IN_MICROSECONDS));
+    } else {
+      PublishSwitchMatrix();
+      UpdateSolenoids();
+      SwitchStrobeState = SWITCH_STROBE_LAMPS;
+      LampStrobeStep = 0;
+      RestartSwitchStrobeTimer(RPU_SWITCH_STROBE_TIMER_COUNT(RPU_OS_LAMP_CHUNK_GAP_IN_MICROSECONDS));
+    }
+  } else if (SwitchStrobeState==SWITCH_STROBE_LAMPS) {
+    if (StrobeLampStep(LampStrobeStep)) {
+      StopSwitchStrobeTimer();
+      SwitchStrobeState = SWITCH_STROBE_IDLE;
+    } else {
+      LampStrobeStep += 1;
+      RestartSwitchStrobeTimer(RPU_SWITCH_STROBE_TIMER_COUNT(RPU_OS_LAMP_CHUNK_GAP_IN_MICROSECONDS));
+    }
+  }
+  RecordInterruptChunk(chunkStart);
+}
+
+
+void InterruptService3() {
+  unsigned int crossingTime = ZERO_CROSSING_TIMER_NOW();
+  unsigned long chunkStart = micros();
+  byte u10AControl = RPU_DataRead(ADDRESS_U10_A_CONTROL);
+  if (u10AControl & 0x80) {
+    // self test switch
+    if (RPU_DataRead(ADDRESS_U10_A_CONTROL) & 0x80) PushToSwitchStack(SW_SELF_TEST_SWITCH);
+    RPU_DataRead(ADDRESS_U10_A);
+  }
+
+  // If we get a weird interupt from U11B, clear it
+  byte u11BControl = RPU_DataRead(ADDRESS_U11_B_CONTROL);
+  if (u11BControl & 0x80) {
+    RPU_DataRead(ADDRESS_U11_B);    
+  }
+
+  byte u11AControl = RPU_DataRead(ADDRESS_U11_A_CONTROL);
+  byte u10BControl = RPU_DataRead(ADDRESS_U10_B_CONTROL);
+
+  // If the interrupt bit on the display interrupt is on, do the display refresh
+  if (u11AControl & 0x80) {
+    RPU_DataRead(ADDRESS_U11_A);
+    numberOfU11Interrupts+=1;
+  }
+
+  // If the IRQ bit of U10BControl is set, do the Zero-crossing interrupt handler
+  boolean zeroCrossing = (u10BControl & 0x80) && (InsideZeroCrossingInterrupt==0);
+  if (zeroCrossing && !RecordZeroCrossing(crossingTime, chunkStart)) {
+    // Too soon after the last crossing - clear it and leave the lamps alone
+    RPU_DataRead(ADDRESS_U10_B);
+    zeroCrossing = false;
+  }
+  if (zeroCrossing) {
+    InsideZeroCrossingInterrupt = InsideZeroCrossingInterrupt + 1;
+
+    byte u10BControlLatest = RPU_DataRead(ADDRESS_U10_B_CONTROL);
+
+    // Backup contents of U10A
+    byte backup10A = RPU_DataRead(ADDRESS_U10_A);
+
     // Latch 0xFF separately without interrupt clear
     RPU_DataWrite(ADDRESS_U10_A, 0xFF);
     RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) | 0x08);
     RPU_DataWrite(ADDRESS_U10_B_CONTROL, RPU_DataRead(ADDRESS_U10_B_CONTROL) & 0xF7);
+    // Read U10B to clear interrupt
+    RPU_DataRead(ADDRESS_U10_B);
 
-    interrupts();
-    noInterrupts();
+    // Turn off U10BControl interrupts
+    RPU_DataWrite(ADDRESS_U10_B_CONTROL, 0x30);
 
-    InsideZeroCrossingInterrupt = 0;
-    RPU_DataWrite(ADDRESS_U10_A, backup10A);
-    RPU_DataWrite(ADDRESS_U10_B_CONTROL, u10BControlLatest);
+    ZeroCrossingBackupU10A = backup10A;
+    ZeroCrossingU10BControl = u10BControlLatest;
 
-    // Read U10B to clear interrupt
-    RPU_DataRead(ADDRESS_U10_B);
-    numberOfU10Interrupts+=1;
+    // Strobe the first column and let Timer2 pace the rest of the scan
+    SwitchStrobeColumn = 0;
+    StrobeSwitchColumn(0);
+    SwitchStrobeState = SWITCH_STROBE_SETTLING;
+    StartSwitchStrobeTimer(RPU_SWITCH_STROBE_TIMER_COUNT(RPU_OS_SWITCH_DELAY_IN_MICROSECONDS));
   }
+  RecordInterruptChunk(chunkStart);
 }
 
 
@@ -2968,6 +4878,8 @@ void RPU_HookInterrupts() {
   TCCR1B |= (1 << CS12) | (1 << CS10);  
   // enable timer compare interrupt
   TIMSK1 |= (1 << OCIE1A);
+  // timestamps for the zero-crossing monitor
+  StartZeroCrossingTimer();
   sei();
   
   attachInterrupt(digitalPinToInterrupt(2), InterruptService3, LOW);
@@ -3260,6 +5172,7 @@ unsigned long RPU_InitializeMPUArch1(unsigned long initOptions, byte creditReset
   // Set up the PIAs
   InitializeU10PIA();
   InitializeU11PIA();
+  LoadBusTiming();
 
   // Read values from MPU dip switches
 #ifdef RPU_OS_USE_DIP_SWITCHES  
@@ -3316,15 +5229,57 @@ volatile byte DisplayStrobe = 0;
 volatile byte InterruptPass = 0;
 boolean NeedToTurnOffTriggeredSolenoids = true;
 #if (RPU_OS_NUM_DIGITS==6)
-byte BlankingBit[16] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x01, 0x02, 0x01, 0x02, 0x04, 0x08, 0x010, 0x20, 0x01, 0x02};
+const byte BlankingBit[16] PROGMEM = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x01, 0x02, 0x01, 0x02, 0x04, 0x08, 0x010, 0x20, 0x01, 0x02};
 #elif (RPU_OS_NUM_DIGITS==7) 
-byte BlankingBit[16] = {0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x02, 0x01, 0x02, 0x04, 0x08, 0x010, 0x20, 0x40};
+const byte BlankingBit[16] PROGMEM = {0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x02, 0x01, 0x02, 0x04, 0x08, 0x010, 0x20, 0x40};
 #endif
 volatile byte UpDownPassCounter = 0;
+volatile byte *FrontLampStates = LampStateBuffers[0];
+// Column strobed on the last interrupt. Each interrupt reads that column
+// and strobes the next, so the strobe has a whole interrupt to settle and 
+// a full scan takes NUM_SWITCH_BYTES interrupts. Debounce lengths count 
+// full scans (see RPU_SetSwitchDebounce), so they're in ~8.3 ms samples.
+#define SWITCH_STROBE_IDLE  0xFF
+volatile byte SwitchStrobeColumn = SWITCH_STROBE_IDLE;
+
+void ScanSwitchColumn() {
+  byte switchCol = SwitchStrobeColumn;
+  if (switchCol!=SWITCH_STROBE_IDLE) {
+    // Read switch input
+    SwitchesNow[switchCol] = RPU_DataRead(PIA_SWITCH_PORT_A);
+
+    // If there are any closures, add them to the switch stack
+    byte validClosures = DebounceSwitchByte(switchCol, NULL);
+    // If there is a valid switch closure (off, then on for the debounce length)
+    if (validClosures) {
+      // Loop on bits of switch byte
+      for (byte bitCount=0; bitCount<8; bitCount++) {
+        // If this switch bit is closed
+        if (validClosures&0x01) {
+          byte validSwitchNum = switchCol*8 + bitCount;
+          PushToSwitchStack(validSwitchNum);
+        }
+        validClosures = validClosures>>1;
+      }        
+    }
+    switchCol += 1;
+  }
+
+  if (switchCol>=NUM_SWITCH_BYTES) {
+    switchCol = 0;
+    PublishSwitchMatrix();
+  }
+  // Turn on the next strobe
+  RPU_DataWrite(PIA_SWITCH_PORT_B, 0x01<<switchCol);
+  SwitchStrobeColumn = switchCol;
+}
+
 
 // INTERRUPT HANDLER
 // for ARCH 10 (WMS)
 ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz)
+  unsigned long chunkStart = micros();
+  RecordDisplayInterruptLatency();
 
   byte displayControlPortB = RPU_DataRead(PIA_DISPLAY_CONTROL_B);
   if (displayControlPortB & 0x80) {
@@ -3344,19 +5299,19 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
   // Create display data
   unsigned int digit1 = 0x0000;
   byte digit2 = 0x00;
-  byte blankingBit = BlankingBit[DisplayStrobe];
+  byte blankingBit = pgm_read_byte(&BlankingBit[DisplayStrobe]);
   if (DisplayStrobe==0) {
     if (DisplayBIPDigitEnable&blankingBit) digit1 = DisplayBIPDigits[0];
     if (DisplayCreditDigitEnable&blankingBit) digit2 = DisplayCreditDigits[0];
   } else if (DisplayStrobe<8) {    
-    if (DisplayDigitEnable[0]&blankingBit) digit1 = FourteenSegmentASCII[DisplayText[0][DisplayStrobe-1]];
-    if (DisplayDigitEnable[2]&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe-1];
+    if (DisplayDigitEnable[0]&DisplayAnimations[0].blinkGate&blankingBit) digit1 = pgm_read_word(&FourteenSegmentASCII[DisplayText[0][DisplayStrobe-1]]);
+    if (DisplayDigitEnable[2]&DisplayAnimations[2].blinkGate&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe-1];
   } else if (DisplayStrobe==8) {
     if (DisplayBIPDigitEnable&blankingBit) digit1 = DisplayBIPDigits[1];
     if (DisplayCreditDigitEnable&blankingBit) digit2 = DisplayCreditDigits[1];
   } else {
-    if (DisplayDigitEnable[1]&blankingBit) digit1 = FourteenSegmentASCII[DisplayText[1][DisplayStrobe-9]];
-    if (DisplayDigitEnable[3]&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-9];
+    if (DisplayDigitEnable[1]&DisplayAnimations[1].blinkGate&blankingBit) digit1 = pgm_read_word(&FourteenSegmentASCII[DisplayText[1][DisplayStrobe-9]]);
+    if (DisplayDigitEnable[3]&DisplayAnimations[3].blinkGate&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-9];
   }
   // Show current display digit
   RPU_DataWrite(PIA_DISPLAY_PORT_A, BoardLEDs|DisplayStrobe);
@@ -3366,15 +5321,15 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
 #elif (RPU_MPU_ARCHITECTURE==13)
   // Create display data
   byte digit1 = 0x0F, digit2 = 0x0F;
-  byte blankingBit = BlankingBit[DisplayStrobe];
+  byte blankingBit = pgm_read_byte(&BlankingBit[DisplayStrobe]);
   boolean comma12 = false, comma34 = false;
 
   if (DisplayStrobe==0) {
     if (DisplayBIPDigitEnable&blankingBit) digit1 = DisplayBIPDigits[0];
     if (DisplayCreditDigitEnable&blankingBit) digit2 = DisplayCreditDigits[0];
   } else if (DisplayStrobe<8) {
-    if (DisplayDigitEnable[0]&blankingBit) digit1 = DisplayDigits[0][DisplayStrobe-1];
-    if (DisplayDigitEnable[2]&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe-1];
+    if (DisplayDigitEnable[0]&DisplayAnimations[0].blinkGate&blankingBit) digit1 = DisplayDigits[0][DisplayStrobe-1];
+    if (DisplayDigitEnable[2]&DisplayAnimations[2].blinkGate&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe-1];
 
     if (DisplayStrobe==1) {
       if (DisplayCommas&0x02) comma12 = true;
@@ -3388,8 +5343,8 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
     if (DisplayBIPDigitEnable&blankingBit) digit1 = DisplayBIPDigits[1];
     if (DisplayCreditDigitEnable&blankingBit) digit2 = DisplayCreditDigits[1];
   } else {
-    if (DisplayDigitEnable[1]&blankingBit) digit1 = DisplayDigits[1][DisplayStrobe-9];
-    if (DisplayDigitEnable[3]&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-9];
+    if (DisplayDigitEnable[1]&DisplayAnimations[1].blinkGate&blankingBit) digit1 = DisplayDigits[1][DisplayStrobe-9];
+    if (DisplayDigitEnable[3]&DisplayAnimations[3].blinkGate&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-9];
 
     if (DisplayStrobe==9) {
       if (DisplayCommas&0x08) comma12 = true;
@@ -3413,15 +5368,15 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
 #else
   // Create display data
   byte digit1 = 0x0F, digit2 = 0x0F;
-  byte blankingBit = BlankingBit[DisplayStrobe];
+  byte blankingBit = pgm_read_byte(&BlankingBit[DisplayStrobe]);
   if (DisplayStrobe<6) {
-    if (DisplayDigitEnable[0]&blankingBit) digit1 = DisplayDigits[0][DisplayStrobe];
-    if (DisplayDigitEnable[2]&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe];
+    if (DisplayDigitEnable[0]&DisplayAnimations[0].blinkGate&blankingBit) digit1 = DisplayDigits[0][DisplayStrobe];
+    if (DisplayDigitEnable[2]&DisplayAnimations[2].blinkGate&blankingBit) digit2 = DisplayDigits[2][DisplayStrobe];
   } else if (DisplayStrobe<8) {
     if (DisplayBIPDigitEnable&blankingBit) digit1 = DisplayBIPDigits[DisplayStrobe-6];
   } else if (DisplayStrobe<14) {
-    if (DisplayDigitEnable[1]&blankingBit) digit1 = DisplayDigits[1][DisplayStrobe-8];
-    if (DisplayDigitEnable[3]&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-8];
+    if (DisplayDigitEnable[1]&DisplayAnimations[1].blinkGate&blankingBit) digit1 = DisplayDigits[1][DisplayStrobe-8];
+    if (DisplayDigitEnable[3]&DisplayAnimations[3].blinkGate&blankingBit) digit2 = DisplayDigits[3][DisplayStrobe-8];
   } else {
     if (DisplayCreditDigitEnable&blankingBit) digit1 = DisplayCreditDigits[DisplayStrobe-14];
   }  
@@ -3433,11 +5388,16 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
 
   DisplayStrobe += 1; 
   if (DisplayStrobe>=16) DisplayStrobe = 0;
+  UpdateDisplayAnimations();
+
+  // Check switches - one column per interrupt
+  ScanSwitchColumn();
 
   if (InterruptPass==0) {
   
     // Show lamps
-    byte curLampByte = LampStates[LampStrobe];
+    if (LampStrobe==0) FrontLampStates = StartLampPass();
+    byte curLampByte = FrontLampStates[LampStrobe];
     if (LampPass%DimDivisor1) curLampByte |= LampDim1[LampStrobe];
     if (LampPass%DimDivisor2) curLampByte |= LampDim2[LampStrobe];
     RPU_DataWrite(PIA_LAMPS_PORT_B, 0x01<<(LampStrobe));
@@ -3457,39 +5417,6 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
       // Clear the interrupt
       RPU_DataRead(PIA_DISPLAY_PORT_A);
     }
-
-    // Check switches
-    byte switchColStrobe = 1;
-    for (byte switchCol=0; switchCol<8; switchCol++) {
-      // Cycle the debouncing variables
-      SwitchesMinus2[switchCol] = SwitchesMinus1[switchCol];
-      SwitchesMinus1[switchCol] = SwitchesNow[switchCol];
-      // Turn on the strobe
-      RPU_DataWrite(PIA_SWITCH_PORT_B, switchColStrobe);
-      // Hold it up for 30 us
-      delayMicroseconds(12);
-      // Read switch input
-      SwitchesNow[switchCol] = RPU_DataRead(PIA_SWITCH_PORT_A);
-      switchColStrobe *= 2;
-    }
-    RPU_DataWrite(PIA_SWITCH_PORT_B, 0);
-    
-    // If there are any closures, add them to the switch stack
-    for (byte switchCol=0; switchCol<NUM_SWITCH_BYTES; switchCol++) {
-      byte validClosures = (SwitchesNow[switchCol] & SwitchesMinus1[switchCol]) & ~SwitchesMinus2[switchCol];
-      // If there is a valid switch closure (off, on, on)
-      if (validClosures) {
-        // Loop on bits of switch byte
-        for (byte bitCount=0; bitCount<8; bitCount++) {
-          // If this switch bit is closed
-          if (validClosures&0x01) {
-            byte validSwitchNum = switchCol*8 + bitCount;
-            PushToSwitchStack(validSwitchNum);
-          }
-          validClosures = validClosures>>1;
-        }        
-      }
-    }
   
   } else {
     // See if any solenoids need to be switched
@@ -3558,6 +5485,7 @@ ISR(TIMER1_COMPA_vect) {    //This is the interrupt request (running at 965.3 Hz
 //  RPU_DataWrite(PIA_SOLENOID_11_PORT_B, InterruptPass);
   InterruptPass ^= 1;
 
+  RecordInterruptChunk(chunkStart);
 }
 
 
@@ -3607,7 +5535,7 @@ boolean CheckCreditResetSwitchArch10(byte creditResetButton) {
 
   RPU_DataWrite(PIA_SWITCH_PORT_B, strobeLine);
   // Hold it up for 30 us
-  delayMicroseconds(12);
+  delayMicroseconds(RPU_OS_SWITCH_DELAY_IN_MICROSECONDS);
 
   // Read switch input
   byte switchValues = RPU_DataRead(PIA_SWITCH_PORT_A);
@@ -3798,6 +5726,9 @@ unsigned long RPU_InitializeMPU(unsigned long initOptions, byte creditResetSwitc
 
   unsigned long retVal = 0;
 
+  // Paint before anything else so the whole run is covered
+  RPU_PaintStack();
+
 #if (RPU_MPU_ARCHITECTURE<10)
   retVal = RPU_InitializeMPUArch1(initOptions, creditResetSwitch);
 #else
@@ -3811,13 +5742,11 @@ unsigned long RPU_InitializeMPU(unsigned long initOptions, byte creditResetSwitc
 
 // Dave's Think Tank - Set a single digit to flash
 void RPU_SetDigitFlash(int displayNumber, int digitNumber, unsigned long value, unsigned long curTime, int period) {
-  // A period of zero toggles display every other time
+  // The display interrupt does the flashing, so curTime isn't needed
+  (void)curTime;
   if (period) {
-    if ((curTime/period)%2) {
-      DisplayDigitEnable[displayNumber] = 127;
-    } else {
-      DisplayDigitEnable[displayNumber] = 127 - (64 >> digitNumber);
-    }
+    DisplayDigitEnable[displayNumber] = 127;
+    RPU_SetDisplayBlink(displayNumber, 64 >> digitNumber, period);
     // BSOS_SetDisplay(displayNumber, value, false, 7);
   }
 }
@@ -3825,23 +5754,19 @@ void RPU_SetDigitFlash(int displayNumber, int digitNumber, unsigned long value,
 
 // Dave's Think Tank - Set a single credit digit to flash
 void RPU_SetDigitFlashCredits(int digit, unsigned long curTime, int period, boolean sixdigits) {
+  (void)curTime;
   if (period) {
-    if ((curTime/period)%2) {
-      DisplayDigitEnable[4] = 108>>(!sixdigits);
-    } else {
-      DisplayDigitEnable[4] = (108 - (8 - digit * 4))>>(!sixdigits);
-    }
+    DisplayDigitEnable[4] = 108>>(!sixdigits);
+    RPU_SetDisplayBlink(4, (8 - digit * 4)>>(!sixdigits), period);
   }
 }
 
 
 // Dave's Think Tank - Set a single ball-in-play digit to flash
 void RPU_SetDigitFlashBallInPlay(int digit, unsigned long curTime, int period, boolean sixdigits) {
+  (void)curTime;
   if (period) {
-    if ((curTime/period)%2) {
-      DisplayDigitEnable[4] = 108>>(!sixdigits);
-    } else {
-      DisplayDigitEnable[4] = (108 - (64 - digit * 32))>>(!sixdigits);
-    }
+    DisplayDigitEnable[4] = 108>>(!sixdigits);
+    RPU_SetDisplayBlink(4, (64 - digit * 32)>>(!sixdigits), period);
   }
 }
@@ -84,12 +84,54 @@ byte RPU_GetDipSwitches(byte index);
 //   Swtiches
 byte RPU_PullFirstFromSwitchStack();
 boolean RPU_ReadSingleSwitchState(byte switchNum);
+// Number of consecutive closed samples before a closure is valid (1-7).
+// A sample is one full scan of the switch matrix, so each one is about
+// 8.3 ms (10 ms with 50 Hz mains) on every MPU: once per zero crossing on
+// -17/-35/100/200 MPUs, and once every eight display interrupts on System
+// 4-11 MPUs (one column per interrupt, so 4x longer than when the whole
+// matrix was read every other interrupt).
+#define RPU_SWITCH_DEBOUNCE_DEFAULT   2
+void RPU_SetSwitchDebounce(byte switchNum, byte numSamples=RPU_SWITCH_DEBOUNCE_DEFAULT);
+void RPU_SetAllSwitchDebounce(byte numSamples=RPU_SWITCH_DEBOUNCE_DEFAULT);
+// Closed switches from the last complete scan, one bit per switch (switch n is byte n/8, bit n%8)
+#define RPU_SWITCH_MATRIX_BYTES       8
+void RPU_GetSwitchMatrixSnapshot(byte *switchBytes);
+byte RPU_PopCount(byte value);
+byte RPU_PopCountBytes(byte *values, byte numBytes);
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+//   Switch recording and replay
+#define RPU_SWITCH_EVENT_CLOSED       0   // pulled from the switch stack
+#define RPU_SWITCH_EVENT_OPENED       1   // opened in the switch matrix
+#define RPU_SWITCH_EVENT_MARKER       2
+#define RPU_SWITCH_EVENT_SEEN_CLOSED  3   // closed in the switch matrix (before it's debounced)
+#define RPU_SWITCH_REPLAY_NO_MARKER   0xFF
+void RPU_RecordSwitchMarker(byte marker);
+byte RPU_GetSwitchEventCount();
+void RPU_ClearSwitchEvents();
+boolean RPU_GetSwitchEvent(byte eventNum, unsigned int *timeDelta, byte *switchNum, byte *edge);
+void RPU_DumpSwitchEvents();
+byte RPU_StartSwitchReplay();
+boolean RPU_IsSwitchReplayActive();
+byte RPU_GetSwitchReplayEventsLeft();
+#endif
+
+//   Interrupt timing (microseconds)
+unsigned int RPU_GetInterruptChunkMaxTime();       // longest time any handler ran with interrupts off
+unsigned int RPU_GetDisplayInterruptMaxLatency();  // latest the display interrupt has started (64us steps on Arch 1)
+unsigned long RPU_GetInterruptChunkOverruns();     // handlers that ran over the budget
+unsigned int RPU_GetInterruptChunkBudget();
+void RPU_ResetInterruptTiming();
 void RPU_PushToSwitchStack(byte switchNumber);
 boolean RPU_GetUpDownSwitchState(); // This always returns true for RPU_MPU_ARCHITECTURE==1 (no up/down switch)
 void RPU_ClearUpDownSwitchState();
 
 //   Solenoids
 void RPU_PushToSolenoidStack(byte solenoidNumber, byte numPushes, boolean disableOverride = false, byte relay = 99);
+#ifndef RPU_OS_SOLENOID_RELAY_SETTLE_TICKS
+#define RPU_OS_SOLENOID_RELAY_SETTLE_TICKS  3   // solenoid stack ticks to wait after the relay switches
+#endif
+void RPU_SetSolenoidRelay(byte relayLamp, byte settleTicks = RPU_OS_SOLENOID_RELAY_SETTLE_TICKS); // relayLamp 99 = no relay, solenoids past RPU_NUM_SOLENOIDS need the relay on
+unsigned long RPU_GetSolenoidRelayFlips();
 void RPU_SetCoinLockout(boolean lockoutOff = false, byte solbit = CONTSOL_DISABLE_COIN_LOCKOUT);
 void RPU_SetDisableFlippers(boolean disableFlippers = true, byte solbit = CONTSOL_DISABLE_FLIPPERS);
 void RPU_SetContinuousSolenoidBit(boolean bitOn, byte solBit = 0x10);
@@ -113,6 +155,12 @@ void RPU_SetDisplayFlash(int displayNumber, unsigned long value, unsigned long c
 void RPU_SetDisplayFlashCredits(unsigned long curTime, int period=100);
 void RPU_CycleAllDisplays(unsigned long curTime, byte digitNum=0, boolean sixdigits=true, boolean display8 = 0); // Self-test function
 byte RPU_GetDisplayBlank(int displayNumber);
+void RPU_SetDisplayBlink(int displayNumber, byte blinkMask, int period=500);
+void RPU_StopDisplayAnimation(int displayNumber);
+#if (RPU_MPU_ARCHITECTURE<15)
+void RPU_SetDisplayCycle(int displayNumber, byte cycleMask);
+void RPU_SetDisplayCycleSequence(byte firstDigit=0, byte lastDigit=9, int period=250);
+#endif
 #if (RPU_MPU_ARCHITECTURE==15)
 byte RPU_SetDisplayText(int displayNumber, char *text, boolean blankByLength=true);
 #endif
@@ -125,11 +173,40 @@ void RPU_SetLampState(int lampNum, byte s_lampState, byte s_lampDim=0, int s_lam
 void RPU_ApplyFlashToLamps(unsigned long curTime);
 void RPU_FlashAllLamps(unsigned long curTime); // Self-test function
 void RPU_TurnOffAllLamps();
+// Lamp banks - bit n of a mask is lamp bankNum*8+n, and only lamps in lampMask change
+void RPU_SetLampBank(byte bankNum, byte lampsOn, byte lampMask=0xFF); // also clears dim & flash
+void RPU_SetLampBankDim(byte bankNum, byte lampDim1, byte lampDim2, byte lampMask=0xFF);
+void RPU_SetLampBankFlash(byte bankNum, int s_lampFlashPeriod, byte lampMask=0xFF);
+void RPU_FillAllLamps(byte s_lampState, byte s_lampDim=0, int s_lampFlashPeriod=0, int numLamps=RPU_MAX_LAMPS);
+// Lamp changes between these two calls are shown together on the next lamp refresh 
+// (calls can be nested, and the frame is shown when the outermost one commits)
+void RPU_BeginLampFrame();
+void RPU_CommitLampFrame();
 void RPU_SetDimDivisor(byte level=1, byte divisor=2); // 2 means 50% duty cycle, 3 means 33%, 4 means 25%...
 byte RPU_ReadLampState(int lampNum);
 byte RPU_ReadLampDim(int lampNum);
 int RPU_ReadLampFlash(int lampNum);
 
+//   Lamp shows
+// A lamp show frame is a duration in ms followed by one byte per lamp bank
+// (a set bit turns the lamp on). For example, a two frame show:
+//   const byte MyShow[] PROGMEM = {
+//     RPU_LAMP_SHOW_DURATION(250), 0x01, 0x00, ...,
+//     RPU_LAMP_SHOW_DURATION(250), 0x02, 0x00, ...
+//   };
+//   RPU_PlayLampShow(MyShow, sizeof(MyShow)/RPU_LAMP_SHOW_FRAME_SIZE);
+#define RPU_LAMP_SHOW_DURATION(ms)  ((ms)&0xFF), (((ms)>>8)&0xFF)
+#define RPU_LAMP_SHOW_FRAME_SIZE    (2+RPU_NUM_LAMP_BANKS)
+#define RPU_LAMP_SHOW_NONE          0
+#define RPU_LAMP_SHOW_ROWS          1   // same bit of every bank
+#define RPU_LAMP_SHOW_COLUMNS       2   // one whole bank at a time
+#define RPU_LAMP_SHOW_CHASE         3   // one lamp at a time
+void RPU_PlayLampShow(const byte *showFrames, unsigned short numFrames, boolean loopShow=true);
+void RPU_PlayBuiltInLampShow(byte showNum, unsigned short frameDuration=250, boolean loopShow=true);
+void RPU_StopLampShow();
+boolean RPU_IsLampShowRunning();
+void RPU_UpdateLampShow(unsigned long curTime);
+
 // Sound Functions
 #ifdef RPU_OS_USE_S_AND_T
 void RPU_PlaySoundSAndT(byte soundByte);
@@ -165,6 +242,40 @@ void RPU_PlayW11Music(byte songNum);
 
 //   General Utility
 byte RPU_DataRead(int address);
+void RPU_DataReadBlock(int address, byte *buffer, int numBytes);
+void RPU_DataFillBlock(int address, byte value, int numBytes);
+void RPU_DataReadWriteBlock(int address, byte *readBuffer, byte writeValue, int numBytes, boolean descending=false);
+unsigned long RPU_CRC32(unsigned long crc, byte *data, int numBytes);
+unsigned long RPU_GetROMCRC32(int startAddress, int numBytes);
+#if (RPU_MPU_ARCHITECTURE<10)
+// Game PROM (U2 on Bally, U1 on Stern) - the rest of the ROM is the same across games
+#define RPU_GAME_ROM_START    0x1000
+#define RPU_GAME_ROM_SIZE     0x0800
+// The rest of the MPU ROM (U6 on Bally, U5 on Stern)
+#define RPU_OS_ROM_START      0x1800
+#define RPU_OS_ROM_SIZE       0x0800
+// MPU RAM
+#define RPU_RAM_6810_START    0x0000
+#define RPU_RAM_6810_SIZE     0x0080
+#define RPU_RAM_5101_START    0x0200
+#define RPU_RAM_5101_SIZE     0x0100
+#define RPU_RAM_5101_MASK     0x0F  // 5101 is 4 bits wide
+unsigned int RPU_TestRAM(int startAddress, int numBytes, byte dataMask=0xFF, int *failAddress=NULL, byte *failBits=NULL, boolean preserveContents=false);
+// Bus timing (microseconds) used by the interrupts
+#define RPU_BUS_TIMING_MAX_LAMP_PADDING     8   // between the lamp strobe's PIA writes
+#define RPU_BUS_TIMING_MAX_DISPLAY_LATCH    16  // display latch strobe width
+#define RPU_BUS_TIMING_MIN_DISPLAY_LATCH    4
+void RPU_GetBusTiming(byte *lampStrobePadding, byte *displayLatchDelay);
+void RPU_SetBusTiming(byte lampStrobePadding, byte displayLatchDelay, boolean saveToEEProm=false);
+// Zero-crossing monitor
+unsigned int RPU_GetZeroCrossingFrequency();    // mains, tenths of a Hz
+unsigned int RPU_GetZeroCrossingPeriod();       // average time between crossings, us
+unsigned int RPU_GetZeroCrossingMaxJitter();    // furthest a period has been from the average, us
+unsigned long RPU_GetZeroCrossingCount();
+unsigned long RPU_GetZeroCrossingRetriggers();  // crossings too soon after the last one (ignored)
+unsigned long RPU_GetZeroCrossingMissed();
+void RPU_ResetZeroCrossingStats();
+#endif
 void RPU_Update(unsigned long currentTime);
 #if RPU_MPU_ARCHITECTURE>9
 void RPU_SetBoardLEDs(boolean LED1, boolean LED2, byte BCDValue = 0xFF);
@@ -176,6 +287,13 @@ void RPU_WriteByteToEEProm(unsigned short startByte, byte value);
 unsigned long RPU_ReadULFromEEProm(unsigned short startByte, unsigned long defaultValue=0);
 void RPU_WriteULToEEProm(unsigned short startByte, unsigned long value);
 
+// SRAM Usage (in bytes)
+void RPU_PaintStack(); // called by RPU_InitializeMPU
+unsigned int RPU_GetFreeSRAM();
+unsigned int RPU_GetUnusedSRAM();
+unsigned int RPU_GetStackHighWater();
+unsigned int RPU_GetStaticSRAM();
+
 
 #ifdef RPU_CPP_FILE
   int NumGameSwitches = 0;
@@ -186,7 +304,7 @@ void RPU_WriteULToEEProm(unsigned short startByte, unsigned long value);
 
 // Alpha numeric numbers and alphabet
 
-const uint16_t SevenSegmentNumbers[10] = {
+const uint16_t SevenSegmentNumbers[10] PROGMEM = {
   0x3F, /* 0 */
   0x06, /* 1 */
   0x5B, /* 2 */
@@ -200,7 +318,7 @@ const uint16_t SevenSegmentNumbers[10] = {
 };
 
 // alphanumeric 14-segment display (ASCII)
-const uint16_t FourteenSegmentASCII[96] = {
+const uint16_t FourteenSegmentASCII[96] PROGMEM = {
   0x0000,/*   converted 0x0000 to 0x0000*/
   0x0006,/* ! converted 0x4006 to 0x0006*/
   0x0102,/* " converted 0x0202 to 0x0102*/
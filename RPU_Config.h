@@ -66,6 +66,7 @@
 //#define RPU_OS_USE_WTYPE_1_SOUND
 //#define RPU_OS_USE_WTYPE_2_SOUND
 //#define RPU_OS_USE_W11_SOUND
+#define RPU_OS_USE_SWITCH_RECORDING
 
 
 #define RPU_OS_USE_6_DIGIT_CREDIT_DISPLAY_WITH_7_DIGIT_DISPLAYS
@@ -140,6 +141,9 @@
 #define RPU_NUM_LAMP_BANKS             8
 #define RPU_MAX_LAMPS                  64
 
+// Time a switch strobe is held up before the returns are read
+#define RPU_OS_SWITCH_DELAY_IN_MICROSECONDS   12
+
 #define NUM_SWITCH_BYTES                8
 #define MAX_NUM_SWITCHES                64
  
@@ -175,11 +179,14 @@
 #define RPU_EEPROM_NUM_SOUNDS                           17 // 1
 #define RPU_EEPROM_SOUND_BOARD                          18 // 1
 #define RPU_EEPROM_MIN_SOUND                            19 // 2
+#define RPU_EEPROM_ROM_CRC                              21 // 4 (fingerprint of the game ROM this row was saved with)
 
 #define RPU_EEPROM_TABLE_ROW_SIZE 30 
 // data byte = RPU_EEPROM_START_TABLE_DATA + RPU_EEPROM_SELECT_GAME * RPU_EEPROM_TABLE_ROW_SIZE + RPU_EEPROM_dataname
 // Row size 30 used to allow future expansion without shifting data
 
+#define RPU_EEPROM_BUS_TIMING                         4010 // 4 (signature, lamp strobe padding, display latch delay, check)
+
 
 
 #define RPU_CONFIG_H
@@ -70,14 +70,60 @@ Version 2024.12 by Dave's Think Tank
   - Extended display test to allow cycling displays with value 8 only.
 - Increase time to stop sound from 1/2 second to one second.
 
+  Changes since version released:
+
+  - Light test: with all lamps selected, light levels 6, 7 and 8 play row, column and chase lamp shows to check the lamp matrix wiring.
+  - Solenoid test: solenoids are scheduled by relay side, and display 2 shows the relay flips per minute.
+  - Locator: light level 9 (with all lamps selected) lights half of the lamps that are left. Click if the lamp you're after is lit, double-click if not,
+    and it's found in about seven answers. Holding reset in the solenoid test does the same for coils, firing the candidates in turn.
+  - New Diagnostics page after the DIP switch test. Click the reset button to step through the views. View 0 shows SRAM usage.
+  - Diagnostics views 1 and 2 run a March C- test on the 6810 and 5101 RAM (failures, first failing address and bit, ms), views 3 and 4
+    show the CRC-32 of the game and OS ROMs. Double-click runs the test again.
+  - Diagnostics view 5 (1 on other MPUs) shows interrupt timing: the longest handler and the latest display refresh in microseconds,
+    and the number of handlers over budget. Double-click starts measuring again.
+  - Light test sets all lamps a bank at a time (RPU_FillAllLamps). Diagnostics view 6 (2 on other MPUs) times turning off every lamp
+    one at a time against a bank at a time.
+  - Locator lamps change together (RPU_BeginLampFrame / RPU_CommitLampFrame) instead of going off and coming back on.
+  - Sound test has the WAV Trigger load the next sound while the current one plays, and starts it as soon as the current one ends.
+  - Button clicks, double-clicks and holds come from ButtonGesture. The display and solenoid tests act on a click right away and take it back if it turns into a double-click or hold.
+  - Diagnostics: switch log view. The other switch dumps the recorded switch events to Serial, double-click replays them.
+  - Diagnostics: loop timing view. Longest and average time through loop() for each page; the other switch steps through the pages, double-click starts over.
+  - Diagnostics: bus timing view. The lamp strobe padding and display latch delay are shortened by hand while watching the lamps and displays, and saved by holding reset.
+  - Diagnostics: zero-crossing view. Mains frequency, worst period jitter, ignored retriggers and missed crossings; double-click starts over.
+  - Switch bounce test: click reset to change the number of samples a switch must read closed (1-7, shown in display 3).
+  - Stuck switch test reads the whole switch matrix at once (RPU_GetSwitchMatrixSnapshot) instead of one switch at a time.
+
  */
 
 #include <Arduino.h>
 #include "SelfTestAndAudit.h"
 #include "RPU_Config.h"
 #include "RPU.h"
+#include "ButtonGesture.h"
 
 #define MACHINE_STATE_ATTRACT         0
+
+// Diagnostics page views (shown in the credit display)
+#define DIAGNOSTIC_VIEW_SRAM          0
+#if (RPU_MPU_ARCHITECTURE<10)
+#define DIAGNOSTIC_VIEW_RAM_6810      1
+#define DIAGNOSTIC_VIEW_RAM_5101      2
+#define DIAGNOSTIC_VIEW_GAME_ROM      3
+#define DIAGNOSTIC_VIEW_OS_ROM        4
+#define DIAGNOSTIC_VIEW_INTERRUPTS    5
+#define DIAGNOSTIC_VIEW_LAMP_SPEED    6
+#define DIAGNOSTIC_VIEW_SWITCH_LOG    7
+#define DIAGNOSTIC_VIEW_LOOP_TIMING   8
+#define DIAGNOSTIC_VIEW_BUS_TIMING    9
+#define DIAGNOSTIC_VIEW_ZERO_CROSSING 10
+#define DIAGNOSTIC_NUM_VIEWS          11
+#else
+#define DIAGNOSTIC_VIEW_INTERRUPTS    1
+#define DIAGNOSTIC_VIEW_LAMP_SPEED    2
+#define DIAGNOSTIC_VIEW_SWITCH_LOG    3
+#define DIAGNOSTIC_VIEW_LOOP_TIMING   4
+#define DIAGNOSTIC_NUM_VIEWS          5
+#endif
 //#define USE_SB100
 
 byte dipBankVal[4];
@@ -106,18 +152,33 @@ unsigned long LastSolTestTime = 0;
 unsigned long LastSelfTestChange = 0;
 unsigned long SavedValue = 0;
 unsigned long SolSwitchTimer = 0;
-unsigned long ResetHold = 0;
-unsigned long otherHold = 0;
-unsigned long NextSpeedyValueChange = 0;
-unsigned long NumSpeedyChanges = 0;
-unsigned long LastResetPress = 0;
-unsigned long LastOtherPress = 0;
 unsigned long LastAnyOtherPress = 0;
+unsigned long RelayFlipWindowStart = 0;
+unsigned long RelayFlipsAtWindowStart = 0;
 
 unsigned long SwitchTimer = 0;
 byte HoldSwitch = SW_SELF_TEST_SWITCH;
 
 byte CurValue = 0;
+byte DiagnosticView = 0;
+#if (RPU_MPU_ARCHITECTURE<10)
+byte BusTimingSelected = 0;       // 0 lamp strobe padding, 1 display latch delay
+boolean BusTimingSaved = false;
+#endif
+byte BounceTestDebounce = RPU_SWITCH_DEBOUNCE_DEFAULT;
+boolean DiagnosticTestRun = false;
+
+// Loop timing - longest pass and a running average (1/16 weight) per machine state
+unsigned int LoopTimeMax[LOOP_TIMING_NUM_STATES];
+unsigned int LoopTimeAverage[LOOP_TIMING_NUM_STATES];
+byte LoopTimingShown = 0;
+
+// Locator - finds an unknown lamp or coil by halving the candidates with each answer
+#define LIGHT_LEVEL_LOCATOR           9
+boolean LocatorActive = false;
+byte LocatorLow = 0;
+byte LocatorHigh = 0;
+byte LocatorNext = 0;
 byte CurDisplay = 0;
 byte CurDigit = 0;
 byte xDigit = 0;
@@ -126,6 +187,8 @@ byte holdDisplay = 0;
 boolean SoundPlayed = false;
 byte SoundPlaying = 0;
 byte SoundToPlay = 0;
+byte SoundPreloaded = 0;
+boolean SoundPreloadValid = false;
 boolean SolenoidCycle = true;
 boolean SolenoidOn = true;
 
@@ -135,10 +198,55 @@ boolean display8s;
 
 byte curSwitch;
 boolean resetDoubleClick = false;
+boolean resetUndoClick = false;
 boolean otherDoubleClick = false;
 boolean anyOtherClick = false;
 boolean anyOtherDoubleClick = false;
 
+// The reset button is clicked, double-clicked and held. The other switch acts 
+// when it goes down, and a second press right after is ignored.
+ButtonGesture ResetButton;
+ButtonGesture OtherButton;
+
+// Pages that can take back a click act on it when the button goes down
+boolean SpeculativeResetClick(int curState) {
+  if (curState == MACHINE_STATE_TEST_DISPLAYS) return true;
+  if (curState == MACHINE_STATE_TEST_SOLENOIDS && !LocatorActive) return true;
+  return false;
+}
+
+void StartLocator(byte lastCandidate) {
+  LocatorActive = true;
+  LocatorLow = 0;
+  LocatorHigh = lastCandidate;
+  LocatorNext = 0;
+}
+
+// The lower half of the candidates is the one being shown
+byte LocatorMiddle() {
+  return (LocatorLow + LocatorHigh) / 2;
+}
+
+// Returns true once a single candidate is left (in LocatorLow)
+boolean LocatorAnswer(boolean inLowerHalf) {
+  if (inLowerHalf) LocatorHigh = LocatorMiddle();
+  else LocatorLow = LocatorMiddle() + 1;
+  LocatorNext = LocatorLow;
+  if (LocatorLow >= LocatorHigh) LocatorActive = false;
+  return !LocatorActive;
+}
+
+void ShowLampLocator() {
+  RPU_BeginLampFrame();
+  RPU_TurnOffAllLamps();
+  for (count = LocatorLow; count <= LocatorMiddle(); count++) {
+    RPU_SetLampState(count, 1);
+  }
+  RPU_CommitLampFrame();
+  RPU_SetDisplay(0, LocatorLow, true);
+  RPU_SetDisplay(2, LocatorHigh, true);
+}
+
 int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long CurrentTime, byte resetSwitch, byte otherSwitch, byte endSwitch) {
   // Set resetSwitch to the game / credit button on the front of your pinball.
   // Set otherSwitch to any other switch easily accessible from the door of your pinball. This is used in some tests, where more than one switch is required to perform all necessary functions.
@@ -149,36 +257,23 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
 
   curSwitch = RPU_PullFirstFromSwitchStack();
   
-  resetDoubleClick = false;
-  otherDoubleClick = false;
   anyOtherClick = false;
   anyOtherDoubleClick = false;
 
-  if (curSwitch == resetSwitch) {
-    curSwitch = SWITCH_STACK_EMPTY;
-    ResetHold = CurrentTime;
-    if ((CurrentTime - LastResetPress) < 400) {
-      resetDoubleClick = true;
-      LastResetPress = 0;
-    }
-    else {
-      LastResetPress = CurrentTime;
-    }
+  if (ResetButton.getSwitch() != resetSwitch || OtherButton.getSwitch() != otherSwitch) {
+    ResetButton.setup(resetSwitch);
+    OtherButton.setup(otherSwitch, GESTURE_DEFAULT_DOUBLE_CLICK_TIME, 0, 0, true);
   }
 
-  if (!RPU_ReadSingleSwitchState(resetSwitch) && CurrentTime - LastResetPress > 400 && LastResetPress != 0) {
-    curSwitch = resetSwitch;
-    LastResetPress = 0;
-  }
+  ResetButton.setSpeculativeClick(SpeculativeResetClick(curState));
+  byte resetGestures = ResetButton.update(curSwitch, CurrentTime);
+  if (curSwitch == resetSwitch) curSwitch = SWITCH_STACK_EMPTY;
+  if (resetGestures & GESTURE_CLICK) curSwitch = resetSwitch;
+  resetDoubleClick = (resetGestures & GESTURE_DOUBLE_CLICK) != 0;
+  resetUndoClick = (resetGestures & GESTURE_UNDO_CLICK) != 0;
 
-  if (curSwitch == otherSwitch) {
-    otherHold = CurrentTime;
-    if ((CurrentTime - LastOtherPress) < 400) {
-      otherDoubleClick = true;
-      curSwitch = SWITCH_STACK_EMPTY;
-    }
-    LastOtherPress = CurrentTime;
-  }
+  otherDoubleClick = (OtherButton.update(curSwitch, CurrentTime) & GESTURE_DOUBLE_CLICK) != 0;
+  if (otherDoubleClick) curSwitch = SWITCH_STACK_EMPTY;
 
   if (curSwitch != resetSwitch && curSwitch != otherSwitch && curSwitch != endSwitch && curSwitch != SW_SELF_TEST_SWITCH && curSwitch != SWITCH_STACK_EMPTY) {
     anyOtherClick = true;
@@ -189,22 +284,11 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
     LastAnyOtherPress = CurrentTime;
   }
 
-  if (ResetHold != 0 && !RPU_ReadSingleSwitchState(resetSwitch)) {
-    ResetHold = 0;
-    NextSpeedyValueChange = 0;
-  }
-
-  boolean resetBeingHeld = false;
-  if (ResetHold != 0 && (CurrentTime - ResetHold) > 1000) {
-    resetBeingHeld = true;
-    LastResetPress = 0;
-    if (NextSpeedyValueChange == 0) {
-      NextSpeedyValueChange = CurrentTime;
-      NumSpeedyChanges = 0;
-    }
-  }
+  boolean resetBeingHeld = ResetButton.beingHeld();
 
   if ((curSwitch == endSwitch) && (curState != MACHINE_STATE_TEST_STUCK_SWITCHES)) {
+    RPU_StopLampShow();
+    RPU_SetAllSwitchDebounce();
     return MACHINE_STATE_ATTRACT;
   }
   
@@ -232,6 +316,12 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       for (count = 0; count < LmaxDropTargets; ++count) 
         LdropTargetID[count] = RPU_ReadByteFromEEProm(RPU_EEPROM_START_TABLE_DATA + (LselectedGame * RPU_EEPROM_TABLE_ROW_SIZE) + RPU_EEPROM_DROP_TARGET_ID + count);
     }
+
+    // Only the light test runs lamp shows
+    RPU_StopLampShow();
+    LocatorActive = false;
+    // Only the bounce test changes the debounce length
+    if (curState != MACHINE_STATE_TEST_SWITCH_BOUNCE) RPU_SetAllSwitchDebounce();
     
     for (count=0; count < LnumDisplays - 1; count++) {
       RPU_SetDisplay(count, 0);
@@ -252,50 +342,86 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       RPU_SetDisplayBallInPlay(1, true, true, LnumCredBIPDigits == 6);
       RPU_TurnOffAllLamps();
       lightLevel = 5; // Flashing
-      for (count = 0; count  <=  LnumLamps; count++) {
-        RPU_SetLampState(count, 1, 0, 500);
-      }
+      RPU_FillAllLamps(1, 0, 500, LnumLamps + 1);
       CurValue = 99;
       RPU_SetDisplay(0, CurValue, true);
       RPU_SetDisplay(1, lightLevel, true);
       LastSolTestTime = CurrentTime;
     }
 
-    if (resetDoubleClick || curSwitch == otherSwitch) {
-      lightLevel += 1;
-      if (lightLevel > 5) lightLevel = 0;
-      if (CurValue == 99) {
-        for (count = 0; count  <=  LnumLamps; count++) {
-          RPU_SetLampState(count, lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
-        }
-      } else {
-        RPU_TurnOffAllLamps();
-        RPU_SetLampState(CurValue, lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
-      }
-      RPU_SetDisplay(1, lightLevel, true);   
-    }
-
-    if (curSwitch==resetSwitch || (resetBeingHeld && CurrentTime > LastSolTestTime + 250)) {
-      LastSolTestTime = CurrentTime;
-      CurValue += 1;
-      if (CurValue>99) {
-        CurValue = 0;
-        lightLevel = 1;
-        RPU_SetDisplay(1, lightLevel, true);
-      }
-      if (CurValue > LnumLamps) {
+    if (LocatorActive) { // Click if one of the lit lamps is the one you're after, double-click if not, hold to stop
+      if (ResetButton.beingHeld()) {
+        ResetButton.cancelHold();
+        LocatorActive = false;
         CurValue = 99;
         lightLevel = 5; // Flashing
+        RPU_FillAllLamps(1, 0, 500, LnumLamps + 1);
+        RPU_SetDisplay(0, CurValue, true);
         RPU_SetDisplay(1, lightLevel, true);
-        for (count = 0; count  <=  LnumLamps; count++) {
-          RPU_SetLampState(count,  lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
+        RPU_SetDisplayBlank(2, 0x00);
+      } else if (curSwitch==resetSwitch || resetDoubleClick || curSwitch == otherSwitch) {
+        if (LocatorAnswer(curSwitch==resetSwitch)) { // Found it
+          CurValue = LocatorLow;
+          lightLevel = 1;
+          RPU_TurnOffAllLamps();
+          RPU_SetLampState(CurValue, 1);
+          RPU_SetDisplay(0, CurValue, true);
+          RPU_SetDisplay(1, lightLevel, true);
+          RPU_SetDisplayBlank(2, 0x00);
+          LastSolTestTime = CurrentTime;
+        } else {
+          ShowLampLocator();
         }
-      } else {
-        RPU_TurnOffAllLamps();
-        RPU_SetLampState(CurValue,  lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
-      }      
-      RPU_SetDisplay(0, CurValue, true);
-    }    
+      }
+    } else {
+      if (resetDoubleClick || curSwitch == otherSwitch) {
+        lightLevel += 1;
+        // With all lamps selected, levels 6-8 are the row, column and chase lamp shows, and 9 is the locator
+        if (lightLevel > (CurValue == 99 ? LIGHT_LEVEL_LOCATOR : 5)) lightLevel = 0;
+        if (CurValue == 99) {
+          if (lightLevel == LIGHT_LEVEL_LOCATOR) {
+            RPU_StopLampShow();
+            StartLocator(LnumLamps);
+            ShowLampLocator();
+          } else if (lightLevel == 6) {
+            RPU_PlayBuiltInLampShow(RPU_LAMP_SHOW_ROWS, 500);
+          } else if (lightLevel == 7) {
+            RPU_PlayBuiltInLampShow(RPU_LAMP_SHOW_COLUMNS, 500);
+          } else if (lightLevel == 8) {
+            RPU_PlayBuiltInLampShow(RPU_LAMP_SHOW_CHASE, 150);
+          } else {
+            RPU_StopLampShow();
+            RPU_FillAllLamps(lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0, LnumLamps + 1);
+          }
+        } else {
+          RPU_TurnOffAllLamps();
+          RPU_SetLampState(CurValue, lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
+        }
+        RPU_SetDisplay(1, lightLevel, true);   
+      }
+
+      // Not if the double-click above just started the locator
+      if (!LocatorActive && (curSwitch==resetSwitch || (ResetButton.beingHeld() && CurrentTime > LastSolTestTime + 250))) {
+        LastSolTestTime = CurrentTime;
+        RPU_StopLampShow();
+        CurValue += 1;
+        if (CurValue>99) {
+          CurValue = 0;
+          lightLevel = 1;
+          RPU_SetDisplay(1, lightLevel, true);
+        }
+        if (CurValue > LnumLamps) {
+          CurValue = 99;
+          lightLevel = 5; // Flashing
+          RPU_SetDisplay(1, lightLevel, true);
+          RPU_FillAllLamps(lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0, LnumLamps + 1);
+        } else {
+          RPU_TurnOffAllLamps();
+          RPU_SetLampState(CurValue,  lightLevel != 0, lightLevel == 5 ? 0: lightLevel - 1, lightLevel == 5 ? 500 : 0);
+        }      
+        RPU_SetDisplay(0, CurValue, true);
+      }    
+    }
   } else if (curState==MACHINE_STATE_TEST_DISPLAYS) { //                                                  *** Test Displays ***
     if (curStateChanged) {
       RPU_TurnOffAllLamps();
@@ -308,15 +434,17 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       LastSolTestTime = CurrentTime;
       display8s = 0;
     }
+    byte lastDisplayStep;
+    if (LnumDigits == 7) lastDisplayStep = (LnumCredBIPDigits == 6) ? 34 : 35;
+    else lastDisplayStep = (LnumCredBIPDigits == 6) ? 30 : 31;
+    if (resetUndoClick) { // The click was the start of a double-click or hold - step back
+      if (CurValue == 0) CurValue = lastDisplayStep;
+      else CurValue -= 1;
+    }
     if (curSwitch==resetSwitch || (resetBeingHeld && CurrentTime > LastSolTestTime + 250)) {
       CurValue += 1;
       LastSolTestTime = CurrentTime;
-      if (LnumDigits == 7) {
-        if (CurValue>(LnumCredBIPDigits == 6 ? 34 : 35)) CurValue = 0;
-      }
-      else {
-        if (CurValue>(LnumCredBIPDigits == 6 ? 30 : 31)) CurValue = 0;
-      }
+      if (CurValue>lastDisplayStep) CurValue = 0;
     }
     if (resetDoubleClick || curSwitch == otherSwitch) display8s = !display8s;
     RPU_CycleAllDisplays(CurrentTime, CurValue, LnumDigits == 6, display8s);
@@ -334,36 +462,83 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       SolenoidCycle = true;
       SolenoidOn = true;
       SavedValue = 0;
+      RPU_SetSolenoidRelay(LsolenoidRelay);
+      RelayFlipWindowStart = CurrentTime;
+      RelayFlipsAtWindowStart = RPU_GetSolenoidRelayFlips();
       RPU_PushToSolenoidStack(SavedValue, 5, false, LsolenoidRelay);
     } 
-    if (curSwitch==resetSwitch) SolenoidCycle = !SolenoidCycle;
-    if (resetDoubleClick || curSwitch == otherSwitch) SolenoidOn = !SolenoidOn;
-    if (curSwitch!=resetSwitch && curSwitch != otherSwitch && curSwitch != endSwitch && curSwitch != SWITCH_STACK_EMPTY && curSwitch != SW_SELF_TEST_SWITCH) {
-      RPU_SetDisplayCredits(curSwitch, true, true, LnumCredBIPDigits == 6);
-      RPU_SetDisplay(3, CurrentTime - SolSwitchTimer, true, 3);
-    }
-    if (!SolenoidOn) {
-      RPU_SetDisplayCredits(99, false); // Blank display when solenoids turned off
-      RPU_SetDisplayBlank(3, 0);
-    }
-
-    if ((CurrentTime-LastSolTestTime)>1000) {
-      if (SolenoidCycle) {
-        SavedValue += 1;
-        if (SavedValue > LnumSolenoids + 2) SavedValue = 0;
+    if (resetUndoClick) SolenoidCycle = !SolenoidCycle; // The click was the start of a double-click or hold
+    // The hold that starts or stops the locator is cancelled, so check the button itself (not resetBeingHeld)
+    if (ResetButton.beingHeld() && !LocatorActive) { // Hold to find an unknown coil by halving the candidates
+      ResetButton.cancelHold();
+      StartLocator(LnumSolenoids);
+      RPU_SetDisplay(0, LocatorLow, true);
+      RPU_SetDisplay(1, LocatorHigh, true);
+      LastSolTestTime = CurrentTime;
+    } else if (LocatorActive) { // Click if the coil you're after is firing, double-click if not, hold to stop
+      if (ResetButton.beingHeld()) {
+        ResetButton.cancelHold();
+        LocatorActive = false;
+        RPU_SetDisplayBlank(1, 0x00);
+      } else if (curSwitch==resetSwitch || resetDoubleClick || curSwitch == otherSwitch) {
+        if (LocatorAnswer(curSwitch==resetSwitch)) { // Found it - keep firing it
+          SavedValue = LocatorLow;
+          SolenoidCycle = false;
+          SolenoidOn = true;
+          RPU_SetDisplay(0, SavedValue, true);
+          RPU_SetDisplayBlank(1, 0x00);
+          LastSolTestTime = CurrentTime - 1000;
+        } else {
+          RPU_SetDisplay(0, LocatorLow, true);
+          RPU_SetDisplay(1, LocatorHigh, true);
+        }
       }
-      if (SolenoidOn) {
-        SolSwitchTimer = CurrentTime;
-
-        if (SavedValue == LnumSolenoids + 1)  // Test coin lockout
-          RPU_SetCoinLockout(coinLockoutOn = !coinLockoutOn);
-        else if (SavedValue == LnumSolenoids + 2)  // Test flipper enable
-          RPU_SetDisableFlippers(flippersOn = !flippersOn);
-        else
-          RPU_PushToSolenoidStack(SavedValue, 5);
+      if (LocatorActive && (CurrentTime - LastSolTestTime) > 250) { // Take turns firing the lower half of the candidates
+        RPU_PushToSolenoidStack(LocatorNext, 5);
+        LocatorNext += 1;
+        if (LocatorNext > LocatorMiddle()) LocatorNext = LocatorLow;
+        LastSolTestTime = CurrentTime;
+      }
+    } else {
+      if (curSwitch==resetSwitch) SolenoidCycle = !SolenoidCycle;
+      if (resetDoubleClick || curSwitch == otherSwitch) SolenoidOn = !SolenoidOn;
+      if (curSwitch!=resetSwitch && curSwitch != otherSwitch && curSwitch != endSwitch && curSwitch != SWITCH_STACK_EMPTY && curSwitch != SW_SELF_TEST_SWITCH) {
+        RPU_SetDisplayCredits(curSwitch, true, true, LnumCredBIPDigits == 6);
+        RPU_SetDisplay(3, CurrentTime - SolSwitchTimer, true, 3);
+      }
+      if (!SolenoidOn) {
+        RPU_SetDisplayCredits(99, false); // Blank display when solenoids turned off
+        RPU_SetDisplayBlank(3, 0);
+      }
+
+      if ((CurrentTime-LastSolTestTime)>1000) {
+        if (SolenoidCycle) {
+          SavedValue += 1;
+          if (SavedValue > LnumSolenoids + 2) SavedValue = 0;
+        }
+        if (SolenoidOn) {
+          SolSwitchTimer = CurrentTime;
+
+          if (SavedValue == LnumSolenoids + 1)  // Test coin lockout
+            RPU_SetCoinLockout(coinLockoutOn = !coinLockoutOn);
+          else if (SavedValue == LnumSolenoids + 2)  // Test flipper enable
+            RPU_SetDisableFlippers(flippersOn = !flippersOn);
+          else
+            RPU_PushToSolenoidStack(SavedValue, 5);
+        }
+        RPU_SetDisplay(0, SavedValue, true);
+        LastSolTestTime = CurrentTime;
+
+        if (LsolenoidRelay != 99) { // Relay flips per minute, over the last minute
+          unsigned long relayFlips = RPU_GetSolenoidRelayFlips() - RelayFlipsAtWindowStart;
+          unsigned long windowTime = CurrentTime - RelayFlipWindowStart;
+          RPU_SetDisplay(1, (relayFlips * 60000) / windowTime, true);
+          if (windowTime > 60000) {
+            RelayFlipWindowStart = CurrentTime;
+            RelayFlipsAtWindowStart += relayFlips;
+          }
+        }
       }
-      RPU_SetDisplay(0, SavedValue, true);
-      LastSolTestTime = CurrentTime;
     }
     
    } else if (curState==MACHINE_STATE_TEST_STUCK_SWITCHES) { //                                                  *** Test Stuck Switches ***
@@ -375,13 +550,22 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       RPU_SetDisplayBallInPlay(4, true, true, LnumCredBIPDigits == 6);
     }
 
+    byte switchMatrix[RPU_SWITCH_MATRIX_BYTES];
+    RPU_GetSwitchMatrixSnapshot(switchMatrix);
     byte displayOutput = 0;
-    for (byte switchCount=0; switchCount<=LnumSwitches; switchCount++) {
-      if (RPU_ReadSingleSwitchState(switchCount)) {
-        if (displayOutput < 4) RPU_SetDisplay(displayOutput, switchCount, true);
+    for (byte switchByte=0; switchByte<RPU_SWITCH_MATRIX_BYTES; switchByte++) {
+      // Only switches up to LnumSwitches count
+      if (switchByte*8 > LnumSwitches) switchMatrix[switchByte] = 0;
+      else if (switchByte*8 + 7 > LnumSwitches) switchMatrix[switchByte] &= (0xFF >> (7 - (LnumSwitches - switchByte*8)));
+
+      for (byte closed = switchMatrix[switchByte]; closed && displayOutput < 4; closed &= (closed - 1)) {
+        byte switchBit = 0;
+        while (!(closed & (1<<switchBit))) switchBit += 1;
+        RPU_SetDisplay(displayOutput, switchByte*8 + switchBit, true);
         displayOutput += 1;
       }
     }
+    displayOutput = RPU_PopCountBytes(switchMatrix, RPU_SWITCH_MATRIX_BYTES);
 
     if (displayOutput<4) {
       for (count=displayOutput; count < LnumDisplays - 1; count++) {
@@ -412,8 +596,18 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
 
       SwitchTimer = 0;
       HoldSwitch = SW_SELF_TEST_SWITCH;
+      BounceTestDebounce = RPU_SWITCH_DEBOUNCE_DEFAULT;
+      RPU_SetAllSwitchDebounce(BounceTestDebounce);
+      RPU_SetDisplay(2, BounceTestDebounce, true);
     }
 
+    if (curSwitch == resetSwitch) { // lengthen the debounce to see how many samples hide a bounce
+      BounceTestDebounce += 1;
+      if (BounceTestDebounce > 7) BounceTestDebounce = 1;
+      RPU_SetAllSwitchDebounce(BounceTestDebounce);
+      RPU_SetDisplay(2, BounceTestDebounce, true);
+      curSwitch = SWITCH_STACK_EMPTY;
+    }
     
     if (curSwitch == HoldSwitch && curSwitch != SWITCH_STACK_EMPTY && curSwitch != SW_SELF_TEST_SWITCH && CurrentTime - SwitchTimer < 500) { // double-hit detected on a single switch
       RPU_SetDisplay(0, curSwitch, true);
@@ -448,6 +642,7 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       // RPU_PlaySoundSquawkAndTalk(SoundToPlay);
       SoundPlaying = SoundToPlay;
       SoundPlayed = true;
+      SoundPreloadValid = false;
       // RPU_SetDisplay(0, (unsigned long)SoundToPlay, true);
       LastSolTestTime = CurrentTime - 5000; // Time the sound started to play (5 seconds ago)
     } 
@@ -477,11 +672,26 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
           RPU_PlaySoundSAndT(SoundToPlay);
         else if (LsoundBoard == 1) {                  // Wave Trigger
           returnState = 10000 + LminSound + SoundToPlay;          // Main program has all the info to play sounds using WAV Trigger!
+          SoundPreloadValid = false;
           }
         
         SoundPlaying = SoundToPlay;
         SoundPlayed = true;
         }
+      else if (LsoundBoard == 1 && (!SoundPlayed || SolenoidCycle)) {
+        // Have the WAV Trigger load the sound that's up next (the main program
+        // keeps it paused and starts it in sync when it's played)
+        byte nextSound = SoundToPlay;
+        if (SoundPlayed) {
+          nextSound += 1;
+          if (nextSound > LnumSounds) nextSound = 0;
+          }
+        if (!SoundPreloadValid || SoundPreloaded != nextSound) {
+          returnState = 20000 + LminSound + nextSound;
+          SoundPreloaded = nextSound;
+          SoundPreloadValid = true;
+          }
+        }
       if ((CurrentTime - LastSolTestTime) >= 5000) {
         if (SolenoidCycle) {
           SoundToPlay += 1;
@@ -489,6 +699,8 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
           }
         LastSolTestTime = CurrentTime;
         SoundPlayed = false;
+        // A loaded sound starts right away, back to back with the last one
+        if (SoundPreloadValid && SoundPreloaded == SoundToPlay) LastSolTestTime = CurrentTime - 1000;
         RPU_SetDisplay(0, (unsigned long) LminSound + SoundToPlay, true);
       }
     }
@@ -636,11 +848,200 @@ int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long Current
       RPU_SetDigitFlash(CurDisplay, CurDigit, DisplayDIP[CurDisplay], CurrentTime, 250);
     else
       RPU_SetDigitFlashCredits(xDigit, CurrentTime, 250, LnumCredBIPDigits == 6);
-  } 
+  } else if (curState==MACHINE_STATE_TEST_DIAGNOSTICS) {  //                                              *** Diagnostics ***
+    if (curStateChanged) {
+      RPU_TurnOffAllLamps();
+      DiagnosticView = DIAGNOSTIC_VIEW_SRAM;
+      RPU_SetDisplayCredits(DiagnosticView, true, true, LnumCredBIPDigits == 6);
+      RPU_SetDisplayBallInPlay(8, true, true, LnumCredBIPDigits == 6);
+      LastSolTestTime = 0;
+    }
+
+    if (curSwitch==resetSwitch) { // next view
+      DiagnosticView += 1;
+      if (DiagnosticView >= DIAGNOSTIC_NUM_VIEWS) DiagnosticView = 0;
+      RPU_SetDisplayCredits(DiagnosticView, true, true, LnumCredBIPDigits == 6);
+      LastSolTestTime = 0;
+      DiagnosticTestRun = false;
+    }
+
+    if (resetDoubleClick) DiagnosticTestRun = false; // run the test again
+
+#if (RPU_MPU_ARCHITECTURE<10)
+
+    if (DiagnosticView >= DIAGNOSTIC_VIEW_RAM_6810 && DiagnosticView <= DIAGNOSTIC_VIEW_OS_ROM && !DiagnosticTestRun) { // memory tests run once per visit
+      DiagnosticTestRun = true;
+      unsigned long testStart = millis();
+      if (DiagnosticView == DIAGNOSTIC_VIEW_RAM_6810 || DiagnosticView == DIAGNOSTIC_VIEW_RAM_5101) {
+        // The 5101 holds the original game's settings and audits, so it's put back afterwards.
+        // On boards with memory protect the 5101 can only be written with the coin door open.
+        int failAddress;
+        byte failBits;
+        unsigned int failures;
+        if (DiagnosticView == DIAGNOSTIC_VIEW_RAM_6810) failures = RPU_TestRAM(RPU_RAM_6810_START, RPU_RAM_6810_SIZE, 0xFF, &failAddress, &failBits, false);
+        else failures = RPU_TestRAM(RPU_RAM_5101_START, RPU_RAM_5101_SIZE, RPU_RAM_5101_MASK, &failAddress, &failBits, true);
+        RPU_SetDisplay(0, failures, true);
+        if (failures) {
+          byte failBit = 0;
+          while (failBit<7 && (failBits & (1<<failBit))==0) failBit += 1;
+          RPU_SetDisplay(1, failAddress, true);   // first failing address
+          RPU_SetDisplay(2, failBit, true);       // lowest failing bit
+        } else {
+          RPU_SetDisplayBlank(1, 0x00);
+          RPU_SetDisplayBlank(2, 0x00);
+        }
+      } else {
+        unsigned long romCRC;
+        if (DiagnosticView == DIAGNOSTIC_VIEW_GAME_ROM) romCRC = RPU_GetROMCRC32(RPU_GAME_ROM_START, RPU_GAME_ROM_SIZE);
+        else romCRC = RPU_GetROMCRC32(RPU_OS_ROM_START, RPU_OS_ROM_SIZE);
+        RPU_SetDisplay(0, romCRC>>16, true);
+        RPU_SetDisplay(1, romCRC&0xFFFF, true);
+        RPU_SetDisplayBlank(2, 0x00);
+      }
+      RPU_SetDisplay(3, millis() - testStart, true); // elapsed ms
+    }
+
+    if (DiagnosticView == DIAGNOSTIC_VIEW_BUS_TIMING) {
+      // Nothing on the bus can show whether a setting is too short, so the
+      // operator shortens it while watching the lamps and displays, and
+      // holds reset to keep it once they still look right
+      byte lampStrobePadding, displayLatchDelay;
+      RPU_GetBusTiming(&lampStrobePadding, &displayLatchDelay);
+      if (curSwitch == otherSwitch) { // shorten the selected setting (wraps back to the longest)
+        if (BusTimingSelected == 0) {
+          lampStrobePadding = (lampStrobePadding == 0) ? RPU_BUS_TIMING_MAX_LAMP_PADDING : (lampStrobePadding - 1);
+        } else {
+          displayLatchDelay = (displayLatchDelay <= RPU_BUS_TIMING_MIN_DISPLAY_LATCH) ? RPU_BUS_TIMING_MAX_DISPLAY_LATCH : (displayLatchDelay - 1);
+        }
+        RPU_SetBusTiming(lampStrobePadding, displayLatchDelay);
+        BusTimingSaved = false;
+        DiagnosticTestRun = false;
+      }
+      if (resetDoubleClick) BusTimingSelected ^= 1; // adjust the other setting
+      if (ResetButton.beingHeld()) { // confirmed by eye - keep these settings
+        ResetButton.cancelHold();
+        RPU_SetBusTiming(lampStrobePadding, displayLatchDelay, true);
+        BusTimingSaved = true;
+        DiagnosticTestRun = false;
+      }
+      if (!DiagnosticTestRun) {
+        DiagnosticTestRun = true;
+        RPU_SetDisplay(0, lampStrobePadding, true);
+        RPU_SetDisplay(1, displayLatchDelay, true);
+        RPU_SetDisplay(2, BusTimingSelected + 1, true);   // setting being adjusted
+        RPU_SetDisplay(3, BusTimingSaved ? 1 : 0, true);  // 1 once saved
+      }
+    }
+
+    if (DiagnosticView == DIAGNOSTIC_VIEW_ZERO_CROSSING && resetDoubleClick) { // start measuring again
+      RPU_ResetZeroCrossingStats();
+      LastSolTestTime = 0;
+    }
+#endif
+
+    if (DiagnosticView == DIAGNOSTIC_VIEW_LAMP_SPEED && !DiagnosticTestRun) { // turn every lamp off one at a time, then a bank at a time
+      DiagnosticTestRun = true;
+      unsigned long testStart = micros();
+      for (count = 0; count < RPU_MAX_LAMPS; count++) RPU_SetLampState(count, 0);
+      RPU_SetDisplay(0, micros() - testStart, true);
+      testStart = micros();
+      RPU_FillAllLamps(0);
+      RPU_SetDisplay(1, micros() - testStart, true);
+      RPU_SetDisplayBlank(2, 0x00);
+      RPU_SetDisplayBlank(3, 0x00);
+    }
+
+    if (DiagnosticView == DIAGNOSTIC_VIEW_LOOP_TIMING) {
+      if (curSwitch == otherSwitch) { // next state that has been timed
+        for (count = 1; count <= LOOP_TIMING_NUM_STATES; count++) {
+          byte nextShown = (LoopTimingShown + count) % LOOP_TIMING_NUM_STATES;
+          if (LoopTimeMax[nextShown]) {
+            LoopTimingShown = nextShown;
+            break;
+          }
+        }
+        LastSolTestTime = 0;
+      }
+      if (resetDoubleClick) { // start measuring again
+        for (count = 0; count < LOOP_TIMING_NUM_STATES; count++) {
+          LoopTimeMax[count] = 0;
+          LoopTimeAverage[count] = 0;
+        }
+        LastSolTestTime = 0;
+      }
+    }
+
+    if (DiagnosticView == DIAGNOSTIC_VIEW_INTERRUPTS && resetDoubleClick) { // start measuring again
+      RPU_ResetInterruptTiming();
+      LastSolTestTime = 0;
+    }
+
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+    if (DiagnosticView == DIAGNOSTIC_VIEW_SWITCH_LOG) {
+      if (curSwitch == otherSwitch) { // dump the recorded switches to Serial
+        RPU_DumpSwitchEvents();
+        LastSolTestTime = 0;
+      }
+      if (resetDoubleClick && !RPU_IsSwitchReplayActive()) { // replay them from the page they were recorded on
+        byte startMarker = RPU_StartSwitchReplay();
+        if (startMarker != RPU_SWITCH_REPLAY_NO_MARKER) returnState = (signed char)startMarker;
+        LastSolTestTime = 0;
+      }
+    }
+#endif
+
+    if (LastSolTestTime == 0 || (CurrentTime - LastSolTestTime) > 500) { // refresh twice a second
+      LastSolTestTime = CurrentTime;
+      if (DiagnosticView == DIAGNOSTIC_VIEW_SRAM) {
+        RPU_SetDisplay(0, RPU_GetFreeSRAM(), true);       // free now
+        RPU_SetDisplay(1, RPU_GetUnusedSRAM(), true);     // never touched by the stack
+        RPU_SetDisplay(2, RPU_GetStackHighWater(), true); // deepest stack
+        RPU_SetDisplay(3, RPU_GetStaticSRAM(), true);     // globals
+      } else if (DiagnosticView == DIAGNOSTIC_VIEW_INTERRUPTS) {
+        RPU_SetDisplay(0, RPU_GetInterruptChunkMaxTime(), true);       // longest handler, us
+        RPU_SetDisplay(1, RPU_GetDisplayInterruptMaxLatency(), true);  // latest display refresh, us
+        RPU_SetDisplay(2, RPU_GetInterruptChunkOverruns(), true);      // handlers over budget
+        RPU_SetDisplay(3, RPU_GetInterruptChunkBudget(), true);
+      } else if (DiagnosticView == DIAGNOSTIC_VIEW_LOOP_TIMING) {
+        // Self-test pages show as 101-108, data entry pages as their step number
+        int timedState = (int)LoopTimingShown + MACHINE_STATE_TEST_DONE;
+        RPU_SetDisplay(0, (timedState < 0) ? (100 - timedState) : (timedState + 1), true);
+        RPU_SetDisplay(1, LoopTimeMax[LoopTimingShown], true);      // longest pass, us
+        RPU_SetDisplay(2, LoopTimeAverage[LoopTimingShown], true);  // average pass, us
+        RPU_SetDisplayBlank(3, 0x00);
+#if (RPU_MPU_ARCHITECTURE<10)
+      } else if (DiagnosticView == DIAGNOSTIC_VIEW_ZERO_CROSSING) {
+        RPU_SetDisplay(0, RPU_GetZeroCrossingFrequency(), true);   // mains, tenths of a Hz
+        RPU_SetDisplay(1, RPU_GetZeroCrossingMaxJitter(), true);   // worst period jitter, us
+        RPU_SetDisplay(2, RPU_GetZeroCrossingRetriggers(), true);  // ignored retriggers
+        RPU_SetDisplay(3, RPU_GetZeroCrossingMissed(), true);      // missed crossings
+#endif
+#ifdef RPU_OS_USE_SWITCH_RECORDING
+      } else if (DiagnosticView == DIAGNOSTIC_VIEW_SWITCH_LOG) {
+        RPU_SetDisplay(0, RPU_GetSwitchEventCount(), true);        // events recorded
+        RPU_SetDisplay(1, RPU_GetSwitchReplayEventsLeft(), true);  // events left to replay
+        RPU_SetDisplayBlank(2, 0x00);
+        RPU_SetDisplayBlank(3, 0x00);
+#endif
+      }
+    }
+  }
   return returnState;
 }
 
 
+void RecordLoopTime(int machineState, unsigned long loopTime) {
+  int timedState = machineState - MACHINE_STATE_TEST_DONE;
+  if (timedState < 0 || timedState >= LOOP_TIMING_NUM_STATES) return;
+  if (loopTime > 0xFFFF) loopTime = 0xFFFF;
+  if (loopTime == 0) loopTime = 1;
+
+  if (loopTime > LoopTimeMax[timedState]) LoopTimeMax[timedState] = loopTime;
+  if (LoopTimeAverage[timedState] == 0) LoopTimeAverage[timedState] = loopTime;
+  else LoopTimeAverage[timedState] = (long)LoopTimeAverage[timedState] + ((long)loopTime - (long)LoopTimeAverage[timedState]) / 16;
+}
+
+
 unsigned long GetLastSelfTestChangedTime() {
   return LastSelfTestChange;
 }
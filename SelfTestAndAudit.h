@@ -32,10 +32,16 @@
 #define MACHINE_STATE_TEST_SWITCH_BOUNCE   -5
 #define MACHINE_STATE_TEST_SOUNDS          -6
 #define MACHINE_STATE_TEST_DIP_SWITCHES    -7
+#define MACHINE_STATE_TEST_DIAGNOSTICS     -8
 
 
-#define MACHINE_STATE_TEST_DONE            -7
+#define MACHINE_STATE_TEST_DONE            -8
 
 unsigned long GetLastSelfTestChangedTime();
 void SetLastSelfTestChangedTime(unsigned long setSelfTestChange);
 int RunBaseSelfTest(int curState, boolean curStateChanged, unsigned long CurrentTime, byte resetSwitch, byte otherSwitch, byte endSwitch);
+
+// Time (in microseconds) taken by each pass through loop() for the machine
+// states from MACHINE_STATE_TEST_DONE up, shown on the diagnostics page
+#define LOOP_TIMING_NUM_STATES             20
+void RecordLoopTime(int machineState, unsigned long loopTime);
@@ -3,6 +3,69 @@
 void SendOnlyWavTrigger::start(void) {
 //  uint8_t txbuf[5];
 	WTSerial.begin(57600);
+	rxCount = 0;
+	rxLen = 0;
+	for (int i = 0; i < MAX_NUM_VOICES; i++) voiceTable[i] = 0xffff;
+}
+
+
+// **************************************************************
+// Reads whatever the WAV Trigger has sent. The only message used is the
+// track report (sent when reporting is on), which keeps the voice table
+// up to date for isTrackPlaying().
+void SendOnlyWavTrigger::update(void) {
+
+uint8_t dat;
+uint8_t voice;
+uint16_t track;
+
+	while (WTSerial.available() > 0) {
+		dat = WTSerial.read();
+		if ((rxCount == 0) && (dat == SOM1)) {
+			rxCount++;
+		}
+		else if (rxCount == 1) {
+			if (dat == SOM2) rxCount++;
+			else rxCount = 0;
+		}
+		else if (rxCount == 2) {
+			if ((dat > 4) && (dat <= MAX_MESSAGE_LEN)) {
+				rxCount++;
+				rxLen = dat - 1;
+			}
+			else rxCount = 0;
+		}
+		else if ((rxCount > 2) && (rxCount < rxLen)) {
+			rxMessage[rxCount - 3] = dat;
+			rxCount++;
+		}
+		else if ((rxCount > 2) && (rxCount == rxLen)) {
+			if ((dat == EOM) && (rxMessage[0] == RSP_TRACK_REPORT)) {
+				// Reported track numbers are zero-based
+				track = rxMessage[2];
+				track = (track << 8) + rxMessage[1] + 1;
+				voice = rxMessage[3];
+				if (voice < MAX_NUM_VOICES) {
+					if (rxMessage[4] == 0) {
+						if (track == voiceTable[voice]) voiceTable[voice] = 0xffff;
+					}
+					else voiceTable[voice] = track;
+				}
+			}
+			rxCount = 0;
+		}
+		else rxCount = 0;
+	}
+}
+
+
+// **************************************************************
+bool SendOnlyWavTrigger::isTrackPlaying(int trk) {
+
+	for (int i = 0; i < MAX_NUM_VOICES; i++) {
+		if (voiceTable[i] == (uint16_t)trk) return true;
+	}
+	return false;
 }
 
 
@@ -41,7 +104,6 @@ uint8_t txbuf[6];
 */
 
 // **************************************************************
-/*
 void SendOnlyWavTrigger::setReporting(bool enable) {
 
 uint8_t txbuf[6];
@@ -54,7 +116,6 @@ uint8_t txbuf[6];
 	txbuf[5] = EOM;
 	WTSerial.write(txbuf, 6);
 }
-*/
 
 // **************************************************************
 void SendOnlyWavTrigger::trackPlaySolo(int trk) {
@@ -53,13 +53,13 @@ public:
 	SendOnlyWavTrigger() {;}
 	~SendOnlyWavTrigger() {;}
 	void start(void);
-//	void update(void);
+	void update(void);
 //	void flush(void);
-//	void setReporting(bool enable);
+	void setReporting(bool enable);
 //	void setAmpPwr(bool enable);
 //	bool getVersion(char *pDst, int len);
 //	int getNumTracks(void);
-//	bool isTrackPlaying(int trk);
+	bool isTrackPlaying(int trk);
 //	void masterGain(int gain);
 	void stopAllTracks(void);
 	void resumeAllInSync(void);
@@ -84,4 +84,7 @@ private:
 	uint16_t numTracks;
 	uint8_t numVoices;
 	uint8_t rxLen;
+	uint8_t rxCount;
+	uint8_t rxMessage[MAX_MESSAGE_LEN];
+	uint16_t voiceTable[MAX_NUM_VOICES];
 };
@@ -0,0 +1,140 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - Arduino API for building the PTU on Linux
+
+    The Arduino calls run on a virtual clock (16 MHz cycles) instead of
+    the Mega's timers. Time only moves when the program waits
+    (delay, delayMicroseconds), touches the MPU bus (see HostMPU.h), or the
+    driver steps it with HostAdvance. The AVR registers the OS uses are
+    plain variables, except SREG and the TIFR flags, which act like the
+    hardware: setting the I bit runs any interrupt that's due, and writing
+    a 1 to a flag clears it. Timers 1, 2, 3 and 5 count from their
+    registers, and their compare-match handlers are called from the clock.
+
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define RPU_OS_HOST_BUILD
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define PROGMEM
+#define F(s)                    (s)
+#define pgm_read_byte(a)        (*(const uint8_t *)(a))
+#define pgm_read_word(a)        (*(const uint16_t *)(a))
+#define pgm_read_dword(a)       HostReadDword(a)
+#define memcpy_P                memcpy
+inline uint32_t HostReadDword(const void *address) {uint32_t value; memcpy(&value, address, sizeof(value)); return value;}
+#define strcpy_P                strcpy
+
+#define _BV(b)                  (1<<(b))
+#define bit(b)                  (1UL<<(b))
+#define lowByte(w)              ((uint8_t)((w) & 0xFF))
+#define highByte(w)             ((uint8_t)((w) >> 8))
+
+template<class T> T min(T a, T b) {return (a<b)?a:b;}
+template<class T> T max(T a, T b) {return (a>b)?a:b;}
+
+// Virtual clock
+#define HOST_CYCLES_PER_MICROSECOND   16
+extern uint64_t HostCycles;
+void HostAdvance(uint64_t cycles);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Status register - turning the I bit on runs whatever interrupt is due
+struct HostStatusRegister {
+  uint8_t value;
+  operator uint8_t() const {return value;}
+  HostStatusRegister &operator=(uint8_t newValue);
+};
+extern HostStatusRegister SREG;
+void cli();
+void sei();
+#define noInterrupts()  cli()
+#define interrupts()    sei()
+
+// Interrupt flag registers - writing a 1 clears that flag
+struct HostFlagRegister {
+  volatile uint8_t value;
+  operator uint8_t() const {return value;}
+  HostFlagRegister &operator=(uint8_t clearBits) {value &= ~clearBits; return *this;}
+};
+
+#define HOST_PORT(X)  extern volatile uint8_t PORT##X, PIN##X, DDR##X;
+HOST_PORT(A) HOST_PORT(B) HOST_PORT(C) HOST_PORT(D) HOST_PORT(E) HOST_PORT(F)
+HOST_PORT(G) HOST_PORT(H) HOST_PORT(J) HOST_PORT(K) HOST_PORT(L)
+#undef HOST_PORT
+
+#define HOST_TIMER(n)   extern volatile uint8_t TCCR##n##A, TCCR##n##B, TCCR##n##C, TIMSK##n; \
+                        extern HostFlagRegister TIFR##n;
+HOST_TIMER(0) HOST_TIMER(1) HOST_TIMER(2) HOST_TIMER(3) HOST_TIMER(4) HOST_TIMER(5)
+#undef HOST_TIMER
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, TCNT3, OCR3A, TCNT4, OCR4A, TCNT5, OCR5A, ICR5;
+extern volatile uint8_t TCNT0, TCNT2, OCR2A, OCR2B, EIMSK;
+// These are registers on the Mega, so code can test for the timer with #ifdef
+#define TCCR3A  TCCR3A
+#define TCCR5A  TCCR5A
+
+enum {
+  WGM10=0, WGM11=1, WGM12=3, WGM13=4, WGM20=0, WGM21=1, WGM22=3,
+  WGM30=0, WGM31=1, WGM32=3, WGM33=4, WGM50=0, WGM51=1, WGM52=3, WGM53=4,
+  CS10=0, CS11=1, CS12=2, CS20=0, CS21=1, CS22=2, CS30=0, CS31=1, CS32=2, CS50=0, CS51=1, CS52=2,
+  OCIE1A=1, OCIE1B=2, OCIE2A=1, OCIE2B=2, OCIE3A=1, OCIE5A=1, TOIE5=0,
+  OCF1A=1, OCF2A=1, OCF3A=1, OCF5A=1, TOV5=0, INT4=4
+};
+
+// Handlers are ordinary functions here, called by the virtual clock
+#define ISR(vector)     void vector(void)
+void TIMER1_COMPA_vect(void);
+void TIMER2_COMPA_vect(void);
+void TIMER3_COMPA_vect(void);
+
+// SRAM figures come from a stand-in for the Mega's 8K
+#define HOST_SRAM_SIZE        8192
+#define HOST_STATIC_SRAM      2048
+#define __heap_start          HostHeapStart
+extern char HostHeapStart;
+extern char HostSRAM[HOST_SRAM_SIZE];
+#define SP                    ((uintptr_t)(HostSRAM + HOST_SRAM_SIZE - 256))
+#define RAMSTART              ((uintptr_t)&HostHeapStart - HOST_STATIC_SRAM)
+#define RAMEND                ((uintptr_t)(HostSRAM + HOST_SRAM_SIZE - 1))
+
+// Pins
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+#define digitalPinToInterrupt(p)  ((p)==2 ? 0 : -1)
+void attachInterrupt(int interruptNum, void (*handler)(void), int mode);
+void detachInterrupt(int interruptNum);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+#include "HardwareSerial.h"
+
+#endif
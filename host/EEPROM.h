@@ -0,0 +1,32 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the Mega's 4K EEPROM, kept in memory. It starts
+    erased (0xFF) like a new board. HostLoadEEPROM/HostSaveEEPROM keep it
+    in a file between runs.
+
+ */
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+#define HOST_EEPROM_SIZE    4096
+
+struct EEPROMClass {
+  uint8_t data[HOST_EEPROM_SIZE];
+  unsigned long writes;
+
+  uint8_t read(int address) {return (address>=0 && address<HOST_EEPROM_SIZE) ? data[address] : 0xFF;}
+  void write(int address, uint8_t value) {if (address>=0 && address<HOST_EEPROM_SIZE) {data[address] = value; writes += 1;}}
+  void update(int address, uint8_t value) {if (read(address)!=value) write(address, value);}
+  uint16_t length() {return HOST_EEPROM_SIZE;}
+};
+extern EEPROMClass EEPROM;
+
+void HostEraseEEPROM();
+boolean HostLoadEEPROM(const char *fileName);
+boolean HostSaveEEPROM(const char *fileName);
+
+#endif
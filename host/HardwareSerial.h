@@ -0,0 +1,61 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - serial ports
+
+    Everything written to a port is kept (up to a limit) so a driver can
+    look at it, and copied to stdout when echo is on. Bytes a driver
+    queues with queueInput() are handed back by read().
+
+ */
+
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include "Arduino.h"
+
+#define HOST_SERIAL_CAPTURE_SIZE    65536
+#define HOST_SERIAL_INPUT_SIZE      1024
+
+class HardwareSerial
+{
+public:
+  HardwareSerial();
+
+  void begin(unsigned long baud) {(void)baud;}
+  void end() {;}
+  operator bool() {return true;}
+
+  size_t write(uint8_t data);
+  size_t write(const char *text);
+  size_t write(const uint8_t *buffer, size_t length);
+  size_t print(const char *text) {return write(text);}
+  size_t print(long value, int base = 10);
+  size_t println(const char *text = "");
+  size_t println(long value, int base = 10);
+  void flush() {;}
+
+  int available();
+  int read();
+
+  // For drivers
+  boolean echo;
+  void clearCapture();
+  const char *capture() {return captured;}
+  unsigned long captureLength() {return capturedLength;}
+  void queueInput(const uint8_t *buffer, size_t length);
+
+private:
+  char captured[HOST_SERIAL_CAPTURE_SIZE + 1];
+  unsigned long capturedLength;
+  uint8_t input[HOST_SERIAL_INPUT_SIZE];
+  unsigned int inputFirst;
+  unsigned int inputLast;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
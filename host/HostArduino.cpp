@@ -0,0 +1,424 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - virtual clock, timers, interrupts, pins, serial
+    ports and EEPROM (see Arduino.h)
+
+ */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "HostMPU.h"
+#include "HostSim.h"
+
+uint64_t HostCycles = 0;
+HostStatusRegister SREG = {0x80};
+
+#define HOST_PORT(X)  volatile uint8_t PORT##X, PIN##X, DDR##X;
+HOST_PORT(A) HOST_PORT(B) HOST_PORT(C) HOST_PORT(D) HOST_PORT(E) HOST_PORT(F)
+HOST_PORT(G) HOST_PORT(H) HOST_PORT(J) HOST_PORT(K) HOST_PORT(L)
+#undef HOST_PORT
+
+#define HOST_TIMER(n)   volatile uint8_t TCCR##n##A, TCCR##n##B, TCCR##n##C, TIMSK##n; \
+                        HostFlagRegister TIFR##n;
+HOST_TIMER(0) HOST_TIMER(1) HOST_TIMER(2) HOST_TIMER(3) HOST_TIMER(4) HOST_TIMER(5)
+#undef HOST_TIMER
+volatile uint16_t TCNT1, OCR1A, OCR1B, TCNT3, OCR3A, TCNT4, OCR4A, TCNT5, OCR5A, ICR5;
+volatile uint8_t TCNT0, TCNT2, OCR2A, OCR2B, EIMSK;
+
+char HostHeapStart;
+char HostSRAM[HOST_SRAM_SIZE];
+char *__brkval = HostSRAM + HOST_STATIC_SRAM;
+
+EEPROMClass EEPROM;
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+
+unsigned long HostInterruptEntryCycles = HOST_INTERRUPT_ENTRY_DEFAULT_CYCLES;
+unsigned long HostInterruptCount[HOST_NUM_INTERRUPTS];
+uint64_t HostLongestInterruptsOff = 0;
+uint64_t HostInterruptMaxLatency[HOST_NUM_INTERRUPTS];
+uint64_t InterruptsOffSince = 0;
+
+
+/******************************************************
+ *   Timers
+ */
+
+struct HostTimer {
+  volatile uint8_t *controlA;
+  volatile uint8_t *controlB;
+  volatile uint8_t *mask;
+  HostFlagRegister *flags;
+  volatile uint16_t *count16;
+  volatile uint16_t *compare16;
+  volatile uint8_t *count8;
+  volatile uint8_t *compare8;
+  boolean isTimer2;
+  uint32_t prescalerPhase;
+  uint64_t flaggedAt;
+};
+
+HostTimer HostTimers[] = {
+  {&TCCR1A, &TCCR1B, &TIMSK1, &TIFR1, &TCNT1, &OCR1A, NULL, NULL, false, 0, 0},
+  {&TCCR2A, &TCCR2B, &TIMSK2, &TIFR2, NULL, NULL, &TCNT2, &OCR2A, true, 0, 0},
+  {&TCCR3A, &TCCR3B, &TIMSK3, &TIFR3, &TCNT3, &OCR3A, NULL, NULL, false, 0, 0},
+  {&TCCR5A, &TCCR5B, &TIMSK5, &TIFR5, &TCNT5, &OCR5A, NULL, NULL, false, 0, 0}
+};
+#define HOST_NUM_TIMERS   (sizeof(HostTimers)/sizeof(HostTimers[0]))
+#define TIMER_1           0
+#define TIMER_2           1
+#define TIMER_3           2
+#define HOST_NO_EVENT     0xFFFFFFFFFFFFFFFFULL
+
+uint32_t TimerPrescaler(HostTimer *timer) {
+  static const uint16_t timer2Prescalers[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+  static const uint16_t timerPrescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  byte clockSelect = *timer->controlB & 0x07;
+  return timer->isTimer2 ? timer2Prescalers[clockSelect] : timerPrescalers[clockSelect];
+}
+
+boolean TimerInCTCMode(HostTimer *timer) {
+  if (timer->isTimer2) return (*timer->controlA & (1<<WGM21)) && !(*timer->controlB & (1<<WGM22));
+  return (*timer->controlB & (1<<WGM12)) && !(*timer->controlB & (1<<WGM13)) && !(*timer->controlA & 0x03);
+}
+
+uint32_t TimerCount(HostTimer *timer) {
+  return timer->count8 ? *timer->count8 : *timer->count16;
+}
+
+void SetTimerCount(HostTimer *timer, uint32_t count) {
+  if (timer->count8) *timer->count8 = (uint8_t)count;
+  else *timer->count16 = (uint16_t)count;
+}
+
+// Timer ticks until the counter next wraps (at the compare value in CTC mode)
+uint32_t TicksToWrap(HostTimer *timer) {
+  uint32_t count = TimerCount(timer);
+  uint32_t top = timer->count8 ? 0xFF : 0xFFFF;
+  uint32_t compare = timer->compare8 ? *timer->compare8 : *timer->compare16;
+  if (TimerInCTCMode(timer) && count<=compare) return compare - count + 1;
+  return top - count + 1;
+}
+
+uint64_t CyclesToNextTimerEvent() {
+  uint64_t soonest = HOST_NO_EVENT;
+  for (unsigned int timerNum=0; timerNum<HOST_NUM_TIMERS; timerNum++) {
+    HostTimer *timer = &HostTimers[timerNum];
+    uint32_t prescaler = TimerPrescaler(timer);
+    if (prescaler==0) continue;
+    uint64_t cycles = (uint64_t)TicksToWrap(timer)*prescaler - timer->prescalerPhase;
+    if (cycles<soonest) soonest = cycles;
+  }
+  return soonest;
+}
+
+// A step ends at the next wrap, so a compare match is flagged at the end
+void RunTimers(uint64_t cycles) {
+  for (unsigned int timerNum=0; timerNum<HOST_NUM_TIMERS; timerNum++) {
+    HostTimer *timer = &HostTimers[timerNum];
+    uint32_t prescaler = TimerPrescaler(timer);
+    if (prescaler==0) continue;
+    uint64_t phase = timer->prescalerPhase + cycles;
+    uint64_t ticks = phase/prescaler;
+    timer->prescalerPhase = phase%prescaler;
+    if (ticks==0) continue;
+
+    // The step never goes past the next wrap
+    uint32_t ticksToWrap = TicksToWrap(timer);
+    if (ticks>=ticksToWrap) {
+      boolean compareMatch = TimerInCTCMode(timer) && TimerCount(timer)<=(timer->compare8 ? *timer->compare8 : *timer->compare16);
+      SetTimerCount(timer, ticks - ticksToWrap);
+      if (compareMatch && !(timer->flags->value & (1<<OCF1A))) {
+        timer->flags->value |= (1<<OCF1A);
+        timer->flaggedAt = HostCycles + cycles;
+      }
+    } else {
+      SetTimerCount(timer, TimerCount(timer) + ticks);
+    }
+  }
+}
+
+
+/******************************************************
+ *   Interrupts
+ */
+
+void (*ExternalInterruptHandler)(void) = NULL;
+
+void attachInterrupt(int interruptNum, void (*handler)(void), int mode) {
+  // Only the MPU's IRQ (pin 2, level triggered) is wired up
+  if (interruptNum!=0 || mode!=LOW) return;
+  ExternalInterruptHandler = handler;
+  EIMSK |= (1<<INT4);
+  HostServiceInterrupts();
+}
+
+void detachInterrupt(int interruptNum) {
+  if (interruptNum!=0) return;
+  EIMSK &= ~(1<<INT4);
+  ExternalInterruptHandler = NULL;
+}
+
+boolean TimerInterruptDue(HostTimer *timer, byte interruptNum) {
+  if ((timer->flags->value & (1<<OCF1A)) && (*timer->mask & (1<<OCIE1A))) {
+    // The flag is cleared when the handler starts
+    timer->flags->value &= ~(1<<OCF1A);
+    uint64_t latency = HostCycles - timer->flaggedAt;
+    if (latency>HostInterruptMaxLatency[interruptNum]) HostInterruptMaxLatency[interruptNum] = latency;
+    return true;
+  }
+  return false;
+}
+
+void InterruptsOff() {
+  if (!(SREG.value & 0x80)) return;
+  SREG.value &= 0x7F;
+  InterruptsOffSince = HostCycles;
+}
+
+void InterruptsOn() {
+  if (SREG.value & 0x80) return;
+  SREG.value |= 0x80;
+  if ((HostCycles - InterruptsOffSince)>HostLongestInterruptsOff) HostLongestInterruptsOff = HostCycles - InterruptsOffSince;
+}
+
+void HostResetInterruptTiming() {
+  HostLongestInterruptsOff = 0;
+  memset(HostInterruptMaxLatency, 0, sizeof(HostInterruptMaxLatency));
+  if (!(SREG.value & 0x80)) InterruptsOffSince = HostCycles;
+}
+
+// Runs the handlers that are due, highest priority (lowest vector) first,
+// the same way the AVR does: one handler at a time with interrupts off
+void HostServiceInterrupts() {
+  while (SREG.value & 0x80) {
+    void (*handler)(void) = NULL;
+    byte interruptNum;
+    if (ExternalInterruptHandler && (EIMSK & (1<<INT4)) && HostMPUIRQ()) {
+      handler = ExternalInterruptHandler;
+      interruptNum = HOST_INTERRUPT_MPU_IRQ;
+    } else if (TimerInterruptDue(&HostTimers[TIMER_2], HOST_INTERRUPT_TIMER2)) {
+      handler = TIMER2_COMPA_vect;
+      interruptNum = HOST_INTERRUPT_TIMER2;
+    } else if (TimerInterruptDue(&HostTimers[TIMER_1], HOST_INTERRUPT_TIMER1)) {
+      handler = TIMER1_COMPA_vect;
+      interruptNum = HOST_INTERRUPT_TIMER1;
+    } else if (TimerInterruptDue(&HostTimers[TIMER_3], HOST_INTERRUPT_TIMER3)) {
+      handler = TIMER3_COMPA_vect;
+      interruptNum = HOST_INTERRUPT_TIMER3;
+    } else {
+      return;
+    }
+
+    InterruptsOff();
+    HostInterruptCount[interruptNum] += 1;
+    HostAdvance(HostInterruptEntryCycles);
+    handler();
+    InterruptsOn();
+  }
+}
+
+HostStatusRegister &HostStatusRegister::operator=(uint8_t newValue) {
+  value = (value & 0x80) | (newValue & 0x7F);
+  if (newValue & 0x80) {
+    InterruptsOn();
+    HostServiceInterrupts();
+  } else {
+    InterruptsOff();
+  }
+  return *this;
+}
+
+void cli() {
+  InterruptsOff();
+}
+
+void sei() {
+  SREG = SREG.value | 0x80;
+}
+
+
+/******************************************************
+ *   Virtual clock
+ */
+
+void HostAdvance(uint64_t cycles) {
+  uint64_t endCycle = HostCycles + cycles;
+  do {
+    uint64_t step = endCycle - HostCycles;
+    uint64_t timerEvent = CyclesToNextTimerEvent();
+    if (timerEvent<step) step = timerEvent;
+    uint64_t mpuEvent = HostMPUNextEvent();
+    if (mpuEvent<=HostCycles) step = 0;
+    else if ((mpuEvent - HostCycles)<step) step = mpuEvent - HostCycles;
+
+    RunTimers(step);
+    HostCycles += step;
+    HostMPUUpdate();
+    HostServiceInterrupts();
+  } while (HostCycles<endCycle);
+}
+
+unsigned long millis() {
+  return (unsigned long)(HostCycles/(HOST_CYCLES_PER_MICROSECOND*1000));
+}
+
+unsigned long micros() {
+  return (unsigned long)(HostCycles/HOST_CYCLES_PER_MICROSECOND);
+}
+
+void delay(unsigned long ms) {
+  HostAdvance((uint64_t)ms*HOST_CYCLES_PER_MICROSECOND*1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  HostAdvance((uint64_t)us*HOST_CYCLES_PER_MICROSECOND);
+}
+
+
+/******************************************************
+ *   Pins
+ */
+
+#define HOST_NUM_PINS   70
+uint8_t HostPinModes[HOST_NUM_PINS];
+uint8_t HostPinLevels[HOST_NUM_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin<HOST_NUM_PINS) HostPinModes[pin] = mode;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin<HOST_NUM_PINS) ? HostPinLevels[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin<HOST_NUM_PINS && HostPinModes[pin]==OUTPUT) HostPinLevels[pin] = value ? HIGH : LOW;
+}
+
+void HostSetPin(uint8_t pin, uint8_t level) {
+  if (pin<HOST_NUM_PINS) HostPinLevels[pin] = level;
+}
+
+
+/******************************************************
+ *   Random numbers (the same sequence every run)
+ */
+
+unsigned long HostRandomState = 1;
+
+void randomSeed(unsigned long seed) {
+  HostRandomState = seed ? seed : 1;
+}
+
+long random(long howBig) {
+  if (howBig<=0) return 0;
+  HostRandomState = HostRandomState*1103515245UL + 12345UL;
+  return (long)((HostRandomState>>8)%(unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall>=howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+
+/******************************************************
+ *   Serial ports
+ */
+
+HardwareSerial::HardwareSerial() {
+  echo = false;
+  capturedLength = 0;
+  captured[0] = 0;
+  inputFirst = 0;
+  inputLast = 0;
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  if (capturedLength<HOST_SERIAL_CAPTURE_SIZE) {
+    captured[capturedLength++] = (char)data;
+    captured[capturedLength] = 0;
+  }
+  if (echo) fputc(data, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const char *text) {
+  size_t length = strlen(text);
+  return write((const uint8_t *)text, length);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t length) {
+  for (size_t count=0; count<length; count++) write(buffer[count]);
+  return length;
+}
+
+size_t HardwareSerial::print(long value, int base) {
+  char text[40];
+  if (base==16) snprintf(text, sizeof(text), "%lX", value);
+  else snprintf(text, sizeof(text), "%ld", value);
+  return write(text);
+}
+
+size_t HardwareSerial::println(const char *text) {
+  return write(text) + write("\r\n");
+}
+
+size_t HardwareSerial::println(long value, int base) {
+  return print(value, base) + write("\r\n");
+}
+
+int HardwareSerial::available() {
+  return (int)((inputLast + HOST_SERIAL_INPUT_SIZE - inputFirst)%HOST_SERIAL_INPUT_SIZE);
+}
+
+int HardwareSerial::read() {
+  if (inputFirst==inputLast) return -1;
+  uint8_t data = input[inputFirst];
+  inputFirst = (inputFirst + 1)%HOST_SERIAL_INPUT_SIZE;
+  return data;
+}
+
+void HardwareSerial::clearCapture() {
+  capturedLength = 0;
+  captured[0] = 0;
+}
+
+void HardwareSerial::queueInput(const uint8_t *buffer, size_t length) {
+  for (size_t count=0; count<length; count++) {
+    unsigned int nextLast = (inputLast + 1)%HOST_SERIAL_INPUT_SIZE;
+    if (nextLast==inputFirst) return;
+    input[inputLast] = buffer[count];
+    inputLast = nextLast;
+  }
+}
+
+
+/******************************************************
+ *   EEPROM
+ */
+
+void HostEraseEEPROM() {
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.writes = 0;
+}
+
+boolean HostLoadEEPROM(const char *fileName) {
+  FILE *file = fopen(fileName, "rb");
+  if (file==NULL) return false;
+  boolean loaded = (fread(EEPROM.data, 1, sizeof(EEPROM.data), file)==sizeof(EEPROM.data));
+  fclose(file);
+  return loaded;
+}
+
+boolean HostSaveEEPROM(const char *fileName) {
+  FILE *file = fopen(fileName, "wb");
+  if (file==NULL) return false;
+  boolean saved = (fwrite(EEPROM.data, 1, sizeof(EEPROM.data), file)==sizeof(EEPROM.data));
+  fclose(file);
+  return saved;
+}
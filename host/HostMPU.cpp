@@ -0,0 +1,272 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - MPU model (see HostMPU.h)
+
+ */
+
+#include "HostMPU.h"
+
+#define PIA_U10                   0
+#define PIA_U11                   1
+#define PIA_BASE_U10              0x88
+#define PIA_BASE_U11              0x90
+
+// 6821 control register bits
+#define PIA_CONTROL_IRQ1_ENABLE   0x01
+#define PIA_CONTROL_DATA_ACCESS   0x04
+#define PIA_CONTROL_C2_OUTPUT     0x38  // C2 is a manual output when bits 4 and 5 are set
+#define PIA_CONTROL_C2_HIGH       0x08
+#define PIA_CONTROL_IRQ1_FLAG     0x80
+#define PIA_CONTROL_FLAGS         0xC0
+
+#define RAM_6810_START            0x0000
+#define RAM_6810_END              0x007F
+#define RAM_5101_START            0x0200
+#define RAM_5101_END              0x02FF
+
+#define LAMP_SLOTS                23    // 15 main addresses, 8 aux banks
+#define LAMP_NO_SLOT              0xFF
+
+// The display interrupt from the MPU's 555 (U11:CA1)
+#define DISPLAY_TIMER_HZ          320
+
+struct PIAState {
+  byte outputA, directionA, controlA;
+  byte outputB, directionB, controlB;
+};
+
+unsigned int HostBusAccessCycles = HOST_BUS_ACCESS_DEFAULT_CYCLES;
+unsigned long HostBusReads = 0;
+unsigned long HostBusWrites = 0;
+
+PIAState PIAs[2];
+byte MPUMemory[0x10000];
+byte SwitchColumns[8];
+byte DipSwitchBanks[4];
+
+byte LatchedLampSlot = LAMP_NO_SLOT;
+byte LampsOnThisCycle[LAMP_SLOTS];
+byte LampsOn[LAMP_SLOTS];
+unsigned long LampLatches = 0;
+
+byte MainsHz = 60;
+uint64_t NextCrossingCycle = 0;
+unsigned long CrossingCount = 0;
+uint64_t NextDisplayTimerCycle = 0;
+
+
+void HostMPUReset() {
+  memset(PIAs, 0, sizeof(PIAs));
+  memset(MPUMemory, 0, sizeof(MPUMemory));
+  memset(SwitchColumns, 0, sizeof(SwitchColumns));
+  memset(DipSwitchBanks, 0, sizeof(DipSwitchBanks));
+  memset(LampsOnThisCycle, 0, sizeof(LampsOnThisCycle));
+  memset(LampsOn, 0, sizeof(LampsOn));
+  LatchedLampSlot = LAMP_NO_SLOT;
+  LampLatches = 0;
+  HostBusReads = 0;
+  HostBusWrites = 0;
+  CrossingCount = 0;
+  HostSetMainsFrequency(60);
+  NextDisplayTimerCycle = HostCycles + (16000000UL/DISPLAY_TIMER_HZ);
+}
+
+byte *HostMPUMemory() {
+  return MPUMemory;
+}
+
+
+/******************************************************
+ *   Playfield
+ */
+
+void HostSetSwitch(byte switchNum, boolean closed) {
+  if (switchNum>=40) return;
+  if (closed) SwitchColumns[switchNum/8] |= (1<<(switchNum%8));
+  else SwitchColumns[switchNum/8] &= ~(1<<(switchNum%8));
+}
+
+boolean HostGetSwitch(byte switchNum) {
+  if (switchNum>=40) return false;
+  return (SwitchColumns[switchNum/8]>>(switchNum%8)) & 0x01;
+}
+
+void HostSetDipSwitches(byte bank, byte value) {
+  if (bank<4) DipSwitchBanks[bank] = value;
+}
+
+void HostPressSelfTest() {
+  PIAs[PIA_U10].controlA |= PIA_CONTROL_IRQ1_FLAG;
+}
+
+// Lamps are numbered like RPU_SetLampState: four per slot
+boolean HostLampIsOn(byte lampNum) {
+  byte slot = lampNum/4;
+  if (slot>=LAMP_SLOTS) return false;
+  return (LampsOn[slot]>>(lampNum%4)) & 0x01;
+}
+
+unsigned long HostLampLatches() {
+  return LampLatches;
+}
+
+
+/******************************************************
+ *   Zero crossings and the display timer
+ */
+
+void HostSetMainsFrequency(byte hz) {
+  MainsHz = hz;
+  if (hz) NextCrossingCycle = HostCycles + (8000000UL/hz);
+}
+
+unsigned long HostZeroCrossings() {
+  return CrossingCount;
+}
+
+uint64_t HostMPUNextEvent() {
+  uint64_t nextEvent = NextDisplayTimerCycle;
+  if (MainsHz && NextCrossingCycle<nextEvent) nextEvent = NextCrossingCycle;
+  return nextEvent;
+}
+
+void HostMPUUpdate() {
+  if (MainsHz && HostCycles>=NextCrossingCycle) {
+    // An SCR stays on until the next crossing, so this is what was lit
+    memcpy(LampsOn, LampsOnThisCycle, sizeof(LampsOn));
+    memset(LampsOnThisCycle, 0, sizeof(LampsOnThisCycle));
+    PIAs[PIA_U10].controlB |= PIA_CONTROL_IRQ1_FLAG;
+    CrossingCount += 1;
+    NextCrossingCycle += 8000000UL/MainsHz;
+  }
+  if (HostCycles>=NextDisplayTimerCycle) {
+    PIAs[PIA_U11].controlA |= PIA_CONTROL_IRQ1_FLAG;
+    NextDisplayTimerCycle += 16000000UL/DISPLAY_TIMER_HZ;
+  }
+}
+
+boolean HostMPUIRQ() {
+  for (byte pia=0; pia<2; pia++) {
+    if ((PIAs[pia].controlA & PIA_CONTROL_IRQ1_FLAG) && (PIAs[pia].controlA & PIA_CONTROL_IRQ1_ENABLE)) return true;
+    if ((PIAs[pia].controlB & PIA_CONTROL_IRQ1_FLAG) && (PIAs[pia].controlB & PIA_CONTROL_IRQ1_ENABLE)) return true;
+  }
+  return false;
+}
+
+
+/******************************************************
+ *   Bus
+ */
+
+byte SwitchReturns(byte strobes, boolean cb2High) {
+  byte returns = 0;
+  for (byte column=0; column<5; column++) {
+    if (strobes & (1<<column)) returns |= SwitchColumns[column];
+  }
+  for (byte bank=0; bank<3; bank++) {
+    if (strobes & (0x20<<bank)) returns |= DipSwitchBanks[bank];
+  }
+  if (cb2High) returns |= DipSwitchBanks[3];
+  return returns;
+}
+
+byte PIAInputA(byte pia) {
+  (void)pia;
+  return 0xFF;
+}
+
+byte PIAInputB(byte pia) {
+  if (pia==PIA_U10) {
+    PIAState *u10 = &PIAs[PIA_U10];
+    byte strobes = u10->outputA & u10->directionA;
+    boolean cb2High = (u10->controlB & PIA_CONTROL_C2_OUTPUT)==PIA_CONTROL_C2_OUTPUT;
+    return SwitchReturns(strobes, cb2High);
+  }
+  return 0xFF;
+}
+
+byte ReadPIA(byte pia, byte reg) {
+  PIAState *state = &PIAs[pia];
+  switch (reg) {
+    case 0:
+      if (!(state->controlA & PIA_CONTROL_DATA_ACCESS)) return state->directionA;
+      state->controlA &= ~PIA_CONTROL_FLAGS;
+      return (state->outputA & state->directionA) | (PIAInputA(pia) & ~state->directionA);
+    case 1:
+      return state->controlA;
+    case 2:
+      if (!(state->controlB & PIA_CONTROL_DATA_ACCESS)) return state->directionB;
+      state->controlB &= ~PIA_CONTROL_FLAGS;
+      return (state->outputB & state->directionB) | (PIAInputB(pia) & ~state->directionB);
+    default:
+      return state->controlB;
+  }
+}
+
+// Lamp data is the inhibit nibble on U10:A - a low bit fires that lamp's SCR
+void LampDataWritten(byte data) {
+  if (LatchedLampSlot==LAMP_NO_SLOT) return;
+  LampsOnThisCycle[LatchedLampSlot] |= (~data>>4) & 0x0F;
+}
+
+void LatchLampAddress(byte slot) {
+  LatchedLampSlot = slot;
+  LampLatches += 1;
+}
+
+void WritePIA(byte pia, byte reg, byte data) {
+  PIAState *state = &PIAs[pia];
+  switch (reg) {
+    case 0:
+      if (state->controlA & PIA_CONTROL_DATA_ACCESS) {
+        state->outputA = data;
+        if (pia==PIA_U10) LampDataWritten(data);
+      } else {
+        state->directionA = data;
+      }
+      break;
+    case 1:
+      // The aux lamp board latches its bank (U10:A low nibble) when U11:CA2 drops
+      if (pia==PIA_U11 && (state->controlA & PIA_CONTROL_C2_HIGH) && !(data & PIA_CONTROL_C2_HIGH)) {
+        byte auxBank = PIAs[PIA_U10].outputA & 0x0F;
+        LatchLampAddress((auxBank<(LAMP_SLOTS-15)) ? (15 + auxBank) : LAMP_NO_SLOT);
+      }
+      state->controlA = (state->controlA & PIA_CONTROL_FLAGS) | (data & ~PIA_CONTROL_FLAGS);
+      break;
+    case 2:
+      if (state->controlB & PIA_CONTROL_DATA_ACCESS) state->outputB = data;
+      else state->directionB = data;
+      break;
+    default:
+      // The main lamp boards latch their address when U10:CB2 drops
+      if (pia==PIA_U10 && (state->controlB & PIA_CONTROL_C2_OUTPUT)==PIA_CONTROL_C2_OUTPUT && (data & PIA_CONTROL_C2_OUTPUT)!=PIA_CONTROL_C2_OUTPUT) {
+        byte address = PIAs[PIA_U10].outputA & 0x0F;
+        LatchLampAddress((address<15) ? address : LAMP_NO_SLOT);
+      }
+      state->controlB = (state->controlB & PIA_CONTROL_FLAGS) | (data & ~PIA_CONTROL_FLAGS);
+      break;
+  }
+}
+
+byte HostBusRead(int address) {
+  byte data;
+  address &= 0xFFFF;
+  HostBusReads += 1;
+  if (address>=PIA_BASE_U10 && address<PIA_BASE_U10+4) data = ReadPIA(PIA_U10, address - PIA_BASE_U10);
+  else if (address>=PIA_BASE_U11 && address<PIA_BASE_U11+4) data = ReadPIA(PIA_U11, address - PIA_BASE_U11);
+  else if (address>=RAM_5101_START && address<=RAM_5101_END) data = MPUMemory[address] | 0xF0;
+  else data = MPUMemory[address];
+  HostAdvance(HostBusAccessCycles);
+  return data;
+}
+
+void HostBusWrite(int address, byte data) {
+  address &= 0xFFFF;
+  HostBusWrites += 1;
+  if (address>=PIA_BASE_U10 && address<PIA_BASE_U10+4) WritePIA(PIA_U10, address - PIA_BASE_U10, data);
+  else if (address>=PIA_BASE_U11 && address<PIA_BASE_U11+4) WritePIA(PIA_U11, address - PIA_BASE_U11, data);
+  else if (address>=RAM_6810_START && address<=RAM_6810_END) MPUMemory[address] = data;
+  else if (address>=RAM_5101_START && address<=RAM_5101_END) MPUMemory[address] = data & 0x0F;
+  HostAdvance(HostBusAccessCycles);
+}
@@ -0,0 +1,61 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - a -17 / -35 MPU on the other side of the bus
+
+    RPU.cpp's host build sends RPU_DataRead and RPU_DataWrite here. The
+    model has the two 6821 PIAs (U10 and U11), RAM, a ROM image and the
+    playfield wiring the OS depends on:
+
+    - the switch matrix, strobed on U10:A (columns 0-4) and read on U10:B,
+      with the DIP switches on U10:A bits 5-7 and U10:CB2
+    - the lamp boards, which latch the address in U10:A when U10:CB2 is
+      pulsed and then take the inhibit nibble on U10:A bits 4-7
+    - the zero-crossing signal on U10:CB1 and the self-test switch on
+      U10:CA1, which pull the IRQ line (pin 2) while their interrupts are
+      enabled in the PIA
+
+    Every access costs HostBusAccessCycles on the virtual clock, which is
+    what makes the interrupt timing figures meaningful on the host - the
+    Arduino's own instructions take no virtual time.
+
+ */
+
+#ifndef HOST_MPU_H
+#define HOST_MPU_H
+
+#include "Arduino.h"
+
+// A rev 3 access waits for a PHI2 cycle of the 6800 (about 1.1 us)
+// plus the port setup, so 2 us is used unless a driver changes it
+#define HOST_BUS_ACCESS_DEFAULT_CYCLES    32
+
+extern unsigned int HostBusAccessCycles;
+extern unsigned long HostBusReads;
+extern unsigned long HostBusWrites;
+
+void HostMPUReset();
+byte HostBusRead(int address);
+void HostBusWrite(int address, byte data);
+
+// The MPU's memory (RAM, ROM image) without going through the bus
+byte *HostMPUMemory();
+
+// Playfield
+void HostSetSwitch(byte switchNum, boolean closed);
+boolean HostGetSwitch(byte switchNum);
+void HostSetDipSwitches(byte bank, byte value);
+void HostPressSelfTest();
+boolean HostLampIsOn(byte lampNum);
+unsigned long HostLampLatches();
+
+// 60 or 50 Hz (crossings at twice that), 0 stops them
+void HostSetMainsFrequency(byte hz);
+unsigned long HostZeroCrossings();
+
+// Used by the virtual clock
+uint64_t HostMPUNextEvent();
+void HostMPUUpdate();
+boolean HostMPUIRQ();
+
+#endif
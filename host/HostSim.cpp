@@ -0,0 +1,88 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the driver side (see HostSim.h)
+
+ */
+
+#include <time.h>
+#include "HostSim.h"
+
+unsigned long HostLoopCycles = HOST_LOOP_DEFAULT_CYCLES;
+unsigned long HostLoopPasses = 0;
+HostStateCost HostStateCosts[LOOP_TIMING_NUM_STATES];
+
+void HostPowerOn() {
+  HostEraseEEPROM();
+  HostMPUReset();
+  // The selector switch pulls pin 13 low when it's closed
+  HostSetPin(13, LOW);
+  setup();
+}
+
+// In the sketch
+void SetSelectedGameDefaults();
+boolean WriteSelectedGame(unsigned short game);
+extern byte selectedGame;
+
+void HostSetUpGame() {
+  SetSelectedGameDefaults();
+  WriteSelectedGame(selectedGame);
+  // The game page reads the game back when it starts
+  MachineStateChanged = true;
+}
+
+void HostRunPass() {
+  int passState = MachineState - MACHINE_STATE_TEST_DONE;
+  uint64_t startCycle = HostCycles;
+  uint64_t startBusAccesses = HostBusReads + HostBusWrites;
+  double startWall = HostWallSeconds();
+
+  loop();
+  HostAdvance(HostLoopCycles);
+  HostLoopPasses += 1;
+
+  if (passState>=0 && passState<LOOP_TIMING_NUM_STATES) {
+    HostStateCost *cost = &HostStateCosts[passState];
+    cost->passes += 1;
+    cost->cycles += HostCycles - startCycle;
+    cost->busAccesses += (HostBusReads + HostBusWrites) - startBusAccesses;
+    cost->wallSeconds += HostWallSeconds() - startWall;
+  }
+}
+
+unsigned long HostRunFor(unsigned long milliseconds) {
+  uint64_t endCycle = HostCycles + (uint64_t)milliseconds*HOST_CYCLES_PER_MICROSECOND*1000;
+  unsigned long passes = 0;
+  while (HostCycles<endCycle) {
+    HostRunPass();
+    passes += 1;
+  }
+  return passes;
+}
+
+void HostTapSwitch(byte switchNum, unsigned long holdTime, unsigned long releaseTime) {
+  if (switchNum==HOST_SELF_TEST_SWITCH) {
+    // The PIA flags the edge, so there's nothing to hold
+    HostPressSelfTest();
+  } else {
+    HostSetSwitch(switchNum, true);
+    HostRunFor(holdTime);
+    HostSetSwitch(switchNum, false);
+  }
+  HostRunFor(releaseTime);
+}
+
+boolean HostNextMachineState() {
+  int startState = MachineState;
+  for (byte press=0; press<5 && MachineState==startState; press++) {
+    HostTapSwitch(HOST_SELF_TEST_SWITCH, 0, 300);
+  }
+  return MachineState!=startState;
+}
+
+double HostWallSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec/1.0e9;
+}
@@ -0,0 +1,94 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the driver side
+
+    A driver is an ordinary main() linked with the PTU (the sketch, RPU.cpp
+    and the rest) and the host Arduino. It powers the machine on, calls
+    setup() and loop() itself, and works the playfield through HostMPU.h.
+    Each pass of loop() is charged HostLoopCycles on top of the time its
+    bus accesses and delays take, standing in for the Arduino's own
+    instructions.
+
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "HostMPU.h"
+#include "SelfTestAndAudit.h"
+
+// Interrupt handlers, in the order the AVR would pick them
+#define HOST_INTERRUPT_MPU_IRQ              0
+#define HOST_INTERRUPT_TIMER2               1
+#define HOST_INTERRUPT_TIMER1               2
+#define HOST_INTERRUPT_TIMER3               3
+#define HOST_NUM_INTERRUPTS                 4
+
+// Saving the registers an ISR uses and restoring them (about 4 us)
+#define HOST_INTERRUPT_ENTRY_DEFAULT_CYCLES 64
+// What a pass of loop() costs without its bus accesses (about 100 us)
+#define HOST_LOOP_DEFAULT_CYCLES            1600
+
+// The MPU's self-test switch
+#define HOST_SELF_TEST_SWITCH               0xFF
+
+extern unsigned long HostInterruptEntryCycles;
+extern unsigned long HostInterruptCount[HOST_NUM_INTERRUPTS];
+// Longest time (cycles) interrupts were off, and longest each timer
+// handler waited after its compare match, since HostResetInterruptTiming
+extern uint64_t HostLongestInterruptsOff;
+extern uint64_t HostInterruptMaxLatency[HOST_NUM_INTERRUPTS];
+void HostResetInterruptTiming();
+extern unsigned long HostLoopCycles;
+extern unsigned long HostLoopPasses;
+
+// What the passes of loop() cost in each machine state (indexed from
+// MACHINE_STATE_TEST_DONE, like the diagnostics page's loop timing)
+struct HostStateCost {
+  unsigned long passes;
+  uint64_t cycles;
+  uint64_t busAccesses;
+  double wallSeconds;
+};
+extern HostStateCost HostStateCosts[LOOP_TIMING_NUM_STATES];
+extern int MachineState;
+extern boolean MachineStateChanged;
+
+void HostServiceInterrupts();
+void HostSetPin(uint8_t pin, uint8_t level);
+
+// The sketch
+void setup();
+void loop();
+
+// Erases the EEPROM, resets the MPU and closes the selector switch (so
+// the PTU runs instead of the game's ROM), then runs setup()
+void HostPowerOn();
+
+// Saves the sketch's default game data, as if the data pages had been
+// gone through (a new EEPROM has no valid game, so self-test would go to
+// the data pages instead of the tests)
+void HostSetUpGame();
+
+// Runs loop() once
+void HostRunPass();
+
+// Runs loop() until the virtual clock has moved on by milliseconds and
+// returns the number of passes
+unsigned long HostRunFor(unsigned long milliseconds);
+
+// Closes a switch (or the self-test switch) for holdTime, then opens it
+// and runs for releaseTime
+void HostTapSwitch(byte switchNum, unsigned long holdTime = 100, unsigned long releaseTime = 100);
+
+// Presses self-test until the machine state changes (a press right after
+// a page change is ignored) and returns whether it did
+boolean HostNextMachineState();
+
+// Seconds of real time, for comparing against the virtual clock
+double HostWallSeconds();
+
+#endif
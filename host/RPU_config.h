@@ -0,0 +1,3 @@
+// Some files include the configuration as RPU_config.h, which only
+// finds RPU_Config.h on filesystems that ignore case
+#include "../RPU_Config.h"
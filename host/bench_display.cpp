@@ -0,0 +1,129 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - RPU_SetDisplay against the divide-per-digit version
+
+    Checks that RPU_SetDisplay (double dabble, skipping unchanged values)
+    sets the same digits and blanking as the /10 and %10 loop it replaced,
+    then times both in calls per second. The host divides in hardware and
+    the AVR doesn't, so the gap on the Mega is wider than the one here.
+
+      build/bench_display [calls]
+
+ */
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+
+#define DEFAULT_CALLS       2000000
+#define CHECKED_VALUES      200000
+
+extern volatile byte DisplayDigits[5][RPU_OS_NUM_DIGITS];
+extern volatile byte DisplayDigitEnable[5];
+
+volatile byte ReferenceDigits[RPU_OS_NUM_DIGITS];
+
+// The Mega has no divide instruction, so avr-gcc calls __udivmodsi4 for a
+// 32-bit / and % - one shift and subtract per bit of the quotient
+__attribute__((noinline)) uint32_t SoftwareDivide(uint32_t dividend, uint32_t divisor, uint32_t *remainder) {
+  uint32_t partial = 0;
+  for (byte count=0; count<32; count++) {
+    partial = (partial<<1) | (dividend>>31);
+    dividend = dividend<<1;
+    if (partial>=divisor) {
+      partial -= divisor;
+      dividend |= 1;
+    }
+  }
+  *remainder = partial;
+  return dividend;
+}
+
+// The loop RPU_SetDisplay used before (Arch 1 to 9), dividing the way
+// the host does or the way the Mega does
+template <boolean softwareDivide> __attribute__((noinline)) byte ReferenceSetDisplay(unsigned long value, byte minDigits) {
+  byte blank = 0x00;
+  for (int count=0; count<RPU_OS_NUM_DIGITS; count++) {
+    blank = blank * 2;
+    if (value!=0 || count<minDigits) blank |= 1;
+    if (softwareDivide) {
+      uint32_t remainder;
+      value = SoftwareDivide(value, 10, &remainder);
+      ReferenceDigits[(RPU_OS_NUM_DIGITS-1)-count] = remainder;
+    } else {
+      ReferenceDigits[(RPU_OS_NUM_DIGITS-1)-count] = value%10;
+      value /= 10;
+    }
+  }
+  return blank;
+}
+
+// Mostly small values, like scores and test page numbers, with some of
+// every size and repeats, which RPU_SetDisplay skips
+unsigned long TestValue(unsigned long count) {
+  long kind = random(10);
+  if (kind<4) return random(100);
+  if (kind<6) return random(100000);
+  if (kind<8) return ((unsigned long)random(65536)<<16) | (unsigned long)random(65536);
+  static const unsigned long edges[] = {0, 9, 10, 99, 100, 999999, 1000000, 9999999, 10000000, 0xFFFFFFFFUL};
+  return edges[count%(sizeof(edges)/sizeof(edges[0]))];
+}
+
+boolean CheckDigits() {
+  unsigned long lastValue = 0;
+  for (unsigned long count=0; count<CHECKED_VALUES; count++) {
+    unsigned long value = (count%5==4) ? lastValue : TestValue(count);
+    byte minDigits = (byte)random(RPU_OS_NUM_DIGITS + 2);
+    int displayNumber = (int)random(4);
+    lastValue = value;
+
+    byte blank = RPU_SetDisplay(displayNumber, value, true, minDigits);
+    byte referenceBlank = ReferenceSetDisplay<true>(value, minDigits);
+    boolean same = (blank==referenceBlank) && (DisplayDigitEnable[displayNumber]==referenceBlank);
+    for (byte digit=0; digit<RPU_OS_NUM_DIGITS; digit++) {
+      if (DisplayDigits[displayNumber][digit]!=ReferenceDigits[digit]) same = false;
+    }
+    if (!same) {
+      printf("FAIL: display %d, value %lu, min digits %d: blank 0x%02X (0x%02X before)\n",
+             displayNumber, value, minDigits, blank, referenceBlank);
+      return false;
+    }
+  }
+  printf("%d values give the same digits and blanking\n", CHECKED_VALUES);
+  return true;
+}
+
+void PrintRate(const char *title, unsigned long calls, double seconds) {
+  printf("  %-36s %12.0f calls/s\n", title, seconds>0 ? calls/seconds : 0.0);
+}
+
+int main(int argc, char **argv) {
+  unsigned long calls = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_CALLS;
+
+  boolean passed = CheckDigits();
+
+  // The same values for every run
+  static unsigned long values[1024];
+  for (unsigned int count=0; count<1024; count++) values[count] = TestValue(count);
+
+  printf("Calls per second on this host:\n");
+  double startWall = HostWallSeconds();
+  for (unsigned long count=0; count<calls; count++) ReferenceSetDisplay<false>(values[count&1023], 2);
+  PrintRate("before, host divide", calls, HostWallSeconds() - startWall);
+
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<calls; count++) ReferenceSetDisplay<true>(values[count&1023], 2);
+  PrintRate("before, divide like the Mega", calls, HostWallSeconds() - startWall);
+
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<calls; count++) RPU_SetDisplay(count&3, values[count&1023], true);
+  PrintRate("RPU_SetDisplay, new value", calls, HostWallSeconds() - startWall);
+
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<calls; count++) RPU_SetDisplay(0, values[(count>>10)&1023], true);
+  PrintRate("RPU_SetDisplay, value unchanged", calls, HostWallSeconds() - startWall);
+
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}
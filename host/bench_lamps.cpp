@@ -0,0 +1,168 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the lamp bank calls against a lamp at a time
+
+    Checks that RPU_FillAllLamps, RPU_SetLampBank and RPU_SetLampBankDim
+    leave every lamp's state, dim and flash period the way the
+    RPU_SetLampState loops they replace would, then times both ways of turning all the
+    lamps off, flashing them all, and setting a bank of eight.
+
+      build/bench_lamps [repeats]
+
+ */
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+
+#define DEFAULT_REPEATS     200000
+#define CHECKS              20000
+
+extern volatile byte *LampStates;
+extern volatile byte LampDim1[RPU_NUM_LAMP_BANKS], LampDim2[RPU_NUM_LAMP_BANKS];
+extern volatile byte LampFlashPeriod[RPU_MAX_LAMPS];
+
+struct LampSnapshot {
+  byte states[RPU_NUM_LAMP_BANKS];
+  byte dim1[RPU_NUM_LAMP_BANKS];
+  byte dim2[RPU_NUM_LAMP_BANKS];
+  byte flashPeriod[RPU_MAX_LAMPS];
+};
+
+void TakeSnapshot(LampSnapshot *snapshot) {
+  for (byte bankNum=0; bankNum<RPU_NUM_LAMP_BANKS; bankNum++) {
+    snapshot->states[bankNum] = LampStates[bankNum];
+    snapshot->dim1[bankNum] = LampDim1[bankNum];
+    snapshot->dim2[bankNum] = LampDim2[bankNum];
+  }
+  for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) snapshot->flashPeriod[lampNum] = LampFlashPeriod[lampNum];
+}
+
+void RestoreSnapshot(LampSnapshot *snapshot) {
+  for (byte bankNum=0; bankNum<RPU_NUM_LAMP_BANKS; bankNum++) {
+    LampStates[bankNum] = snapshot->states[bankNum];
+    LampDim1[bankNum] = snapshot->dim1[bankNum];
+    LampDim2[bankNum] = snapshot->dim2[bankNum];
+  }
+  for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) LampFlashPeriod[lampNum] = snapshot->flashPeriod[lampNum];
+}
+
+// Flashing lamps keep whatever state the last flash left them in
+void RandomLamps() {
+  for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) {
+    RPU_SetLampState(lampNum, random(2), random(4), random(3)==0 ? random(50, 1000) : 0);
+  }
+  for (byte bankNum=0; bankNum<RPU_NUM_LAMP_BANKS; bankNum++) LampStates[bankNum] ^= (byte)random(256);
+}
+
+boolean SameLamps(const char *call, LampSnapshot *bankWay, LampSnapshot *lampWay) {
+  for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) {
+    byte bankNum = lampNum/8;
+    byte lampBit = 1<<(lampNum%8);
+    if (((bankWay->states[bankNum]^lampWay->states[bankNum]) & lampBit) || ((bankWay->dim1[bankNum]^lampWay->dim1[bankNum]) & lampBit) ||
+        ((bankWay->dim2[bankNum]^lampWay->dim2[bankNum]) & lampBit) || bankWay->flashPeriod[lampNum]!=lampWay->flashPeriod[lampNum]) {
+      printf("FAIL: %s, lamp %d: states 0x%02X/0x%02X, dim 0x%02X 0x%02X/0x%02X 0x%02X, flash %d/%d\n", call, lampNum,
+             bankWay->states[bankNum], lampWay->states[bankNum], bankWay->dim1[bankNum], bankWay->dim2[bankNum],
+             lampWay->dim1[bankNum], lampWay->dim2[bankNum], bankWay->flashPeriod[lampNum], lampWay->flashPeriod[lampNum]);
+      return false;
+    }
+  }
+  return true;
+}
+
+boolean CheckBankCalls() {
+  static LampSnapshot before, bankWay, lampWay;
+  for (unsigned long count=0; count<CHECKS; count++) {
+    RandomLamps();
+    TakeSnapshot(&before);
+
+    long call = random(3);
+    const char *callName;
+    if (call==0) {
+      byte lampState = random(2);
+      byte lampDim = random(4);
+      int flashPeriod = random(2) ? random(50, 1000) : 0;
+      int numLamps = random(1, RPU_MAX_LAMPS + 1);
+      callName = "RPU_FillAllLamps";
+      RPU_FillAllLamps(lampState, lampDim, flashPeriod, numLamps);
+      TakeSnapshot(&bankWay);
+      RestoreSnapshot(&before);
+      for (int lampNum=0; lampNum<numLamps; lampNum++) RPU_SetLampState(lampNum, lampState, lampDim, flashPeriod);
+    } else if (call==1) {
+      byte bankNum = random(RPU_NUM_LAMP_BANKS);
+      byte lampsOn = random(256);
+      byte lampMask = random(256);
+      callName = "RPU_SetLampBank";
+      RPU_SetLampBank(bankNum, lampsOn, lampMask);
+      TakeSnapshot(&bankWay);
+      RestoreSnapshot(&before);
+      for (byte bit=0; bit<8 && bankNum*8+bit<RPU_MAX_LAMPS; bit++) {
+        if (lampMask & (1<<bit)) RPU_SetLampState(bankNum*8 + bit, (lampsOn>>bit) & 0x01);
+      }
+    } else {
+      byte bankNum = random(RPU_NUM_LAMP_BANKS);
+      byte lampDim1 = random(256);
+      byte lampDim2 = random(256);
+      byte lampMask = random(256);
+      callName = "RPU_SetLampBankDim";
+      RPU_SetLampBankDim(bankNum, lampDim1, lampDim2, lampMask);
+      TakeSnapshot(&bankWay);
+      // There's no dim-only lamp call, so this one is worked out
+      lampWay = before;
+      lampWay.dim1[bankNum] = (lampWay.dim1[bankNum] & ~lampMask) | (lampDim1 & lampMask);
+      lampWay.dim2[bankNum] = (lampWay.dim2[bankNum] & ~lampMask) | (lampDim2 & lampMask);
+      if (!SameLamps(callName, &bankWay, &lampWay)) return false;
+      continue;
+    }
+    TakeSnapshot(&lampWay);
+    if (!SameLamps(callName, &bankWay, &lampWay)) return false;
+  }
+  printf("%d bank calls leave the lamps the same as a lamp at a time\n", CHECKS);
+  return true;
+}
+
+void PrintTimes(const char *title, unsigned long repeats, double lampSeconds, double bankSeconds) {
+  double lampTime = lampSeconds*1.0e9/repeats;
+  double bankTime = bankSeconds*1.0e9/repeats;
+  printf("  %-26s %10.1f ns %10.1f ns %8.1fx\n", title, lampTime, bankTime, bankTime>0 ? lampTime/bankTime : 0.0);
+}
+
+int main(int argc, char **argv) {
+  unsigned long repeats = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_REPEATS;
+  boolean passed = CheckBankCalls();
+
+  printf("Time per call on this host (%d lamps):\n", RPU_MAX_LAMPS);
+  printf("  %-26s %13s %13s %9s\n", "", "lamp at a time", "bank call", "");
+
+  double startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) {
+    for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) RPU_SetLampState(lampNum, 0);
+  }
+  double lampSeconds = HostWallSeconds() - startWall;
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) RPU_TurnOffAllLamps();
+  PrintTimes("all off", repeats, lampSeconds, HostWallSeconds() - startWall);
+
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) {
+    for (int lampNum=0; lampNum<RPU_MAX_LAMPS; lampNum++) RPU_SetLampState(lampNum, 1, 0, 500);
+  }
+  lampSeconds = HostWallSeconds() - startWall;
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) RPU_FillAllLamps(1, 0, 500);
+  PrintTimes("all flashing", repeats, lampSeconds, HostWallSeconds() - startWall);
+
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) {
+    byte lampsOn = (byte)count;
+    for (byte bit=0; bit<8; bit++) RPU_SetLampState(16 + bit, (lampsOn>>bit) & 0x01);
+  }
+  lampSeconds = HostWallSeconds() - startWall;
+  startWall = HostWallSeconds();
+  for (unsigned long count=0; count<repeats; count++) RPU_SetLampBank(2, (byte)count);
+  PrintTimes("one bank of eight", repeats, lampSeconds, HostWallSeconds() - startWall);
+
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - how long interrupts are held off
+
+    Runs the game page and each test page (the test pages with the
+    playfield switches chattering) and checks the interrupt timing against
+    RPU_OS_INTERRUPT_CHUNK_BUDGET_IN_MICROSECONDS two ways: the OS's own
+    figures (RPU_GetInterruptChunkMaxTime, RPU_GetDisplayInterruptMaxLatency)
+    and the virtual clock's, which sees every stretch with interrupts off
+    and how late each Timer1 (display) interrupt started. The pages are run
+    again with the longest lamp strobe padding and display latch delay.
+
+    Only bus accesses, delays and interrupt entry take virtual time, so the
+    figures leave out the Mega's own instructions - leave some room under
+    the budget for them.
+
+      build/sim_interrupts [seconds per page]
+
+ */
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+#include "PinballTestUnit.h"
+
+#define DEFAULT_SECONDS_PER_PAGE    5
+#define CHATTER_INTERVAL            2     // ms between switch changes
+
+extern byte primarySwitch;
+extern byte secondarySwitch;
+extern byte endSwitch;
+
+boolean Passed = true;
+
+// Switches open and close at random, except the page's buttons
+void RunWithChatter(unsigned long milliseconds) {
+  for (unsigned long elapsed=0; elapsed<milliseconds; elapsed+=CHATTER_INTERVAL) {
+    byte switchNum = (byte)random(40);
+    if (switchNum!=primarySwitch && switchNum!=secondarySwitch && switchNum!=endSwitch) {
+      HostSetSwitch(switchNum, random(2));
+    }
+    HostRunFor(CHATTER_INTERVAL);
+  }
+  for (byte switchNum=0; switchNum<40; switchNum++) HostSetSwitch(switchNum, false);
+}
+
+void CheckPage(const char *settings, unsigned long seconds, boolean chatter) {
+  int page = MachineState;
+  RPU_ResetInterruptTiming();
+  HostResetInterruptTiming();
+  if (chatter) RunWithChatter(seconds*1000);
+  else HostRunFor(seconds*1000);
+
+  unsigned int budget = RPU_GetInterruptChunkBudget();
+  unsigned int chunkTime = RPU_GetInterruptChunkMaxTime();
+  unsigned long overruns = RPU_GetInterruptChunkOverruns();
+  unsigned int displayLatency = RPU_GetDisplayInterruptMaxLatency();
+  double longestOff = (double)HostLongestInterruptsOff/HOST_CYCLES_PER_MICROSECOND;
+  double displayStart = (double)HostInterruptMaxLatency[HOST_INTERRUPT_TIMER1]/HOST_CYCLES_PER_MICROSECOND;
+
+  boolean pagePassed = (overruns==0 && chunkTime<=budget && displayLatency<=budget && longestOff<=budget && displayStart<=budget);
+  printf("  %-8s %5d %10u %9lu %14u %16.1f %14.1f  %s\n", settings, page, chunkTime, overruns,
+         displayLatency, longestOff, displayStart, pagePassed ? "" : "over budget");
+  if (!pagePassed) Passed = false;
+}
+
+void CheckEveryPage(const char *settings, unsigned long seconds) {
+  // Self-test from the game page goes through the test pages and back,
+  // as long as nothing was pressed on the game page
+  CheckPage(settings, seconds, false);
+  for (byte page=0; page<20; page++) {
+    if (!HostNextMachineState() || MachineState==MACHINE_STATE_SELECT_GAME) break;
+    CheckPage(settings, seconds, true);
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long seconds = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_SECONDS_PER_PAGE;
+
+  HostPowerOn();
+  HostSetUpGame();
+  HostRunFor(1000);
+
+  printf("Budget %u us (OS figures in us, display latency in 64 us steps; host figures in us)\n", RPU_GetInterruptChunkBudget());
+  printf("  settings  page  OS chunk  overruns  OS display lat  host ints off  host display lat\n");
+  CheckEveryPage("default", seconds);
+  RPU_SetBusTiming(RPU_BUS_TIMING_MAX_LAMP_PADDING, RPU_BUS_TIMING_MAX_DISPLAY_LATCH);
+  CheckEveryPage("longest", seconds);
+
+  printf(Passed ? "PASS\n" : "FAIL\n");
+  return Passed ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the whole machine on the virtual clock
+
+    Powers the PTU on, steps it through every machine state (the data
+    pages, then the self-tests), soaks it with random button presses, and
+    prints what a pass of loop() costs in each state: its virtual time
+    (HostLoopCycles plus its bus accesses and the interrupts that land in
+    it), the bus accesses it makes, and the real time it takes here. Fails
+    if a state isn't reached or the state machine leaves its range.
+
+      build/sim_machine [soak minutes]
+
+ */
+
+#include "HostSim.h"
+#include "PinballTestUnit.h"
+
+#define DEFAULT_SOAK_MINUTES      10
+#define TIME_IN_EACH_STATE        2000
+#define MAX_SELF_TEST_PRESSES     40
+
+extern byte primarySwitch;
+extern byte secondarySwitch;
+
+boolean StateReached[LOOP_TIMING_NUM_STATES];
+boolean StateOutOfRange = false;
+
+void CheckState() {
+  // The state after the last data page only lasts a pass, saving the game
+  if (MachineState<MACHINE_STATE_TEST_DONE || MachineState>MACHINE_STATE_IDENTIFY_DROP_TARGETS + 1) {
+    StateOutOfRange = true;
+    return;
+  }
+  StateReached[MachineState - MACHINE_STATE_TEST_DONE] = true;
+}
+
+// A couple of presses of the page's buttons, then the rest of the time idle
+void WorkCurrentState() {
+  CheckState();
+  HostTapSwitch(primarySwitch);
+  HostTapSwitch(secondarySwitch);
+  HostTapSwitch(primarySwitch);
+  HostRunFor(TIME_IN_EACH_STATE - 600);
+  CheckState();
+}
+
+void Walk() {
+  // Self-test with nothing else pressed starts the tests
+  for (byte press=0; press<MAX_SELF_TEST_PRESSES && !StateOutOfRange; press++) {
+    HostNextMachineState();
+    CheckState();
+    if (MachineState>=MACHINE_STATE_SELECT_GAME) break;
+    WorkCurrentState();
+  }
+
+  // After a button, it goes through the data pages and saves the game
+  HostTapSwitch(primarySwitch);
+  for (byte press=0; press<MAX_SELF_TEST_PRESSES && !StateOutOfRange; press++) {
+    HostNextMachineState();
+    CheckState();
+    if (MachineState==MACHINE_STATE_SELECT_GAME) break;
+    WorkCurrentState();
+  }
+}
+
+void Soak(unsigned long minutes) {
+  uint64_t endCycle = HostCycles + (uint64_t)minutes*60*1000*1000*HOST_CYCLES_PER_MICROSECOND;
+  while (HostCycles<endCycle && !StateOutOfRange) {
+    long action = random(100);
+    if (action<70) {
+      HostTapSwitch((byte)random(40), random(30, 300), random(50, 500));
+    } else if (action<80) {
+      HostTapSwitch(HOST_SELF_TEST_SWITCH, 0, random(50, 500));
+    } else {
+      // Long enough for the buttons to repeat or count as a hold
+      HostTapSwitch(random(2) ? primarySwitch : secondarySwitch, random(1000, 2500), random(50, 500));
+    }
+    CheckState();
+  }
+}
+
+void PrintCosts(const char *title) {
+  printf("%s\n", title);
+  printf("  state   passes   virtual us/pass   bus accesses/pass   host ns/pass\n");
+  for (int count=0; count<LOOP_TIMING_NUM_STATES; count++) {
+    HostStateCost *cost = &HostStateCosts[count];
+    if (cost->passes==0) continue;
+    printf("  %5d %8lu %17.1f %19.1f %14.1f\n", count + MACHINE_STATE_TEST_DONE, cost->passes,
+           (double)cost->cycles/HOST_CYCLES_PER_MICROSECOND/cost->passes,
+           (double)cost->busAccesses/cost->passes, cost->wallSeconds*1.0e9/cost->passes);
+  }
+  memset(HostStateCosts, 0, sizeof(HostStateCosts));
+}
+
+int main(int argc, char **argv) {
+  unsigned long soakMinutes = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_SOAK_MINUTES;
+  double startWall = HostWallSeconds();
+
+  HostPowerOn();
+  HostSetUpGame();
+  Walk();
+  PrintCosts("Every state:");
+
+  uint64_t soakStartCycle = HostCycles;
+  double soakStartWall = HostWallSeconds();
+  Soak(soakMinutes);
+  double soakWall = HostWallSeconds() - soakStartWall;
+  PrintCosts("Soak:");
+
+  double soakVirtual = (double)(HostCycles - soakStartCycle)/HOST_CYCLES_PER_MICROSECOND/1.0e6;
+  printf("Soaked %.0f s in %.2f s (%.0fx real time), %lu passes of loop() in all, %.2f s\n",
+         soakVirtual, soakWall, soakWall>0 ? soakVirtual/soakWall : 0.0, HostLoopPasses, HostWallSeconds() - startWall);
+
+  boolean passed = !StateOutOfRange;
+  if (StateOutOfRange) printf("FAIL: machine state %d is out of range\n", MachineState);
+  for (int count=0; count<=MACHINE_STATE_IDENTIFY_DROP_TARGETS - MACHINE_STATE_TEST_DONE; count++) {
+    if (!StateReached[count]) {
+      printf("FAIL: machine state %d was never reached\n", count + MACHINE_STATE_TEST_DONE);
+      passed = false;
+    }
+  }
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - switch recording and replay
+
+    For each test page, the simulation is forked just before self-test
+    brings the page up. The copy enters the page with the recording
+    cleared, taps random switches while keeping a trace of the machine
+    state and displays, and dumps the recording to Serial. The dump is
+    read back into the ring, the way one from a machine would be, and
+    replayed from the same point - in another copy and in the original.
+    millis() is the virtual clock, so the replays have to give the
+    recording's trace, and each other's to the millisecond.
+
+      build/sim_replay [taps per page]
+
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+#include "PinballTestUnit.h"
+
+// A tap is seen closed, pulled from the switch stack and opened, and the
+// ring keeps 64 events
+#define DEFAULT_TAPS        16
+#define MAX_TAPS            20
+#define SETTLE_TIME         1000
+// Pages that read RPU_GetSwitchMatrixSnapshot see a replay's switches up
+// to a scan sooner (the machine's is the last complete scan, the replay's
+// is up to date), and their displays can show the difference
+#define TIME_TOLERANCE      3
+#define MAX_TRACE_ENTRIES   4096
+#define MAX_PRESSES         20
+#define MAX_DUMP_LENGTH     4096
+
+extern byte primarySwitch;
+extern byte secondarySwitch;
+extern byte endSwitch;
+extern volatile byte DisplayDigits[5][RPU_OS_NUM_DIGITS];
+extern volatile byte DisplayDigitEnable[5];
+
+// RPU.cpp's ring, for reading a dump back into it
+#ifndef RPU_OS_SWITCH_EVENT_LOG_SIZE
+#define RPU_OS_SWITCH_EVENT_LOG_SIZE  64
+#endif
+struct SwitchEvent {
+  unsigned int timeDelta;
+  byte switchNum;
+  byte edge;
+};
+extern SwitchEvent SwitchEventLog[];
+extern byte SwitchEventLogFirst;
+extern byte SwitchEventLogCount;
+extern unsigned long SwitchEventLastTime;
+extern unsigned long SwitchReplayNextTime;
+// The dump's letter for each edge
+const char EdgeNames[] = "COMS";
+
+// What the page shows, whenever it changes
+struct TraceEntry {
+  unsigned long time;       // ms from entering the page
+  int machineState;
+  byte digits[5][RPU_OS_NUM_DIGITS];
+  byte digitEnable[5];
+};
+
+struct Trace {
+  unsigned long count;
+  unsigned long startTime;
+  TraceEntry entries[MAX_TRACE_ENTRIES];
+};
+
+// Shared with the copies
+struct PageRun {
+  int page;
+  boolean recorded;
+  boolean replayed;
+  unsigned long duration;
+  byte events;
+  char dump[MAX_DUMP_LENGTH + 1];
+  Trace recording;
+  Trace copyReplay;
+};
+
+PageRun *Run;
+Trace Replayed;
+
+boolean SameEntry(TraceEntry *entry, TraceEntry *otherEntry) {
+  return entry->machineState==otherEntry->machineState && !memcmp(entry->digits, otherEntry->digits, sizeof(entry->digits)) &&
+         !memcmp(entry->digitEnable, otherEntry->digitEnable, sizeof(entry->digitEnable));
+}
+
+// Adds an entry if the state or displays have changed
+void TakeTraceEntry(Trace *trace) {
+  TraceEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.time = millis() - trace->startTime;
+  entry.machineState = MachineState;
+  for (byte displayCount=0; displayCount<5; displayCount++) {
+    for (byte digit=0; digit<RPU_OS_NUM_DIGITS; digit++) entry.digits[displayCount][digit] = DisplayDigits[displayCount][digit];
+    entry.digitEnable[displayCount] = DisplayDigitEnable[displayCount];
+  }
+  if (trace->count && SameEntry(&trace->entries[trace->count-1], &entry)) return;
+  if (trace->count<MAX_TRACE_ENTRIES) trace->entries[trace->count++] = entry;
+}
+
+// The first entry is what was showing before the page started
+void StartTrace(Trace *trace, unsigned long startTime) {
+  trace->count = 0;
+  trace->startTime = startTime;
+  TakeTraceEntry(trace);
+}
+
+// Runs a millisecond at a time until the trace is milliseconds long
+void RunTracedUntil(Trace *trace, unsigned long milliseconds) {
+  while (millis() - trace->startTime < milliseconds) {
+    HostRunFor(1);
+    TakeTraceEntry(trace);
+  }
+}
+
+void RunTraced(Trace *trace, unsigned long milliseconds) {
+  RunTracedUntil(trace, millis() - trace->startTime + milliseconds);
+}
+
+// Leaves out changes that last no longer than tolerance, which a replay
+// can catch in a different millisecond from the recording or miss
+unsigned long LastingEntries(Trace *trace, unsigned long tolerance, TraceEntry **entries) {
+  unsigned long numEntries = 0;
+  for (unsigned long count=0; count<trace->count; count++) {
+    TraceEntry *entry = &trace->entries[count];
+    if (count>0 && count+1<trace->count && (entry+1)->time - entry->time <= tolerance) continue;
+    if (numEntries && SameEntry(entries[numEntries-1], entry)) continue;
+    entries[numEntries++] = entry;
+  }
+  return numEntries;
+}
+
+boolean SameTrace(const char *title, Trace *expected, Trace *actual, unsigned long tolerance) {
+  static TraceEntry *expectedEntries[MAX_TRACE_ENTRIES], *actualEntries[MAX_TRACE_ENTRIES];
+  unsigned long numExpected = LastingEntries(expected, tolerance, expectedEntries);
+  unsigned long numActual = LastingEntries(actual, tolerance, actualEntries);
+  for (unsigned long count=0; count<numExpected || count<numActual; count++) {
+    if (count>=numExpected || count>=numActual) {
+      printf("FAIL: %s has %lu changes, not %lu\n", title, numActual, numExpected);
+      return false;
+    }
+    TraceEntry *expectedEntry = expectedEntries[count];
+    TraceEntry *actualEntry = actualEntries[count];
+    long timeDifference = (long)(actualEntry->time - expectedEntry->time);
+    if (!SameEntry(expectedEntry, actualEntry) || timeDifference>(long)tolerance || timeDifference<-(long)tolerance) {
+      printf("FAIL: %s change %lu is %s at %lu ms, not at %lu ms\n", title, count,
+             SameEntry(expectedEntry, actualEntry) ? "the same" : "different", actualEntry->time, expectedEntry->time);
+      return false;
+    }
+  }
+  return true;
+}
+
+// The dump's times are from the first event
+boolean CheckDump(const char *dump) {
+  const char *line = strstr(dump, "* Switch events\n");
+  if (line==NULL) {
+    printf("FAIL: no switch events in the dump\n");
+    return false;
+  }
+  line = strchr(line, '\n') + 1;
+
+  unsigned long eventTime = 0;
+  for (byte eventNum=0; eventNum<RPU_GetSwitchEventCount(); eventNum++) {
+    unsigned int timeDelta;
+    byte switchNum, edge;
+    RPU_GetSwitchEvent(eventNum, &timeDelta, &switchNum, &edge);
+    if (eventNum) eventTime += timeDelta;
+
+    unsigned long dumpedTime;
+    int dumpedSwitch;
+    char dumpedEdge;
+    char expectedEdge = EdgeNames[edge];
+    if (sscanf(line, "%lu,%d,%c", &dumpedTime, &dumpedSwitch, &dumpedEdge)!=3 ||
+        dumpedTime!=eventTime || dumpedSwitch!=switchNum || dumpedEdge!=expectedEdge) {
+      printf("FAIL: dumped event %d isn't %lu,%d,%c\n", eventNum, eventTime, switchNum, expectedEdge);
+      return false;
+    }
+    line = strchr(line, '\n') + 1;
+  }
+  return true;
+}
+
+void LoadDump(const char *dump) {
+  const char *line = strchr(strstr(dump, "* Switch events\n"), '\n') + 1;
+  unsigned long lastTime = 0, eventTime;
+  int switchNum;
+  char edge;
+  RPU_ClearSwitchEvents();
+  while (SwitchEventLogCount<RPU_OS_SWITCH_EVENT_LOG_SIZE && sscanf(line, "%lu,%d,%c", &eventTime, &switchNum, &edge)==3) {
+    SwitchEvent *logEvent = &SwitchEventLog[SwitchEventLogCount++];
+    logEvent->timeDelta = eventTime - lastTime;
+    logEvent->switchNum = switchNum;
+    logEvent->edge = strchr(EdgeNames, edge) - EdgeNames;
+    lastTime = eventTime;
+    line = strchr(line, '\n') + 1;
+  }
+}
+
+// Presses self-test until the next page comes up, with the recording
+// cleared so the page's marker is its first event, and stops after the
+// pass that brings it up (before the page starts)
+int EnterNextPage() {
+  int lastState = MachineState;
+  RPU_ClearSwitchEvents();
+  // A press is often lost - the display interrupt reads U10A (clearing
+  // the PIA's flag) unless a zero crossing sees it first. 300 ms is a
+  // whole number of both periods, so each retry waits a little longer.
+  for (byte press=0; press<MAX_PRESSES && MachineState==lastState; press++) {
+    HostTapSwitch(HOST_SELF_TEST_SWITCH, 0, 0);
+    uint64_t endCycle = HostCycles + (uint64_t)(300 + press)*1000*HOST_CYCLES_PER_MICROSECOND;
+    while (HostCycles<endCycle && MachineState==lastState) HostRunPass();
+  }
+  return MachineState;
+}
+
+// Not the end switch, which leaves the tests (a replay stops at the
+// newest marker, so it would stop there)
+byte RandomSwitch() {
+  long kind = random(4);
+  if (kind==0) return primarySwitch;
+  if (kind==1) return secondarySwitch;
+  byte switchNum;
+  do switchNum = (byte)random(40); while (switchNum==endSwitch);
+  return switchNum;
+}
+
+// The diagnostics page isn't recorded - its buttons dump and replay
+boolean RecordedPage(int page) {
+  return page<MACHINE_STATE_SELECT_GAME && page!=MACHINE_STATE_TEST_DIAGNOSTICS;
+}
+
+void RecordNextPage(unsigned long taps) {
+  Run->page = EnterNextPage();
+  if (!RecordedPage(Run->page)) return;
+
+  // From the page's marker, which is when the replay's times start
+  StartTrace(&Run->recording, SwitchEventLastTime);
+  for (unsigned long count=0; count<taps; count++) {
+    byte switchNum = RandomSwitch();
+    HostSetSwitch(switchNum, true);
+    RunTraced(&Run->recording, random(30, 600));
+    HostSetSwitch(switchNum, false);
+    RunTraced(&Run->recording, random(50, 600));
+  }
+  RunTraced(&Run->recording, SETTLE_TIME);
+  Run->duration = millis() - Run->recording.startTime;
+  Run->events = RPU_GetSwitchEventCount();
+
+  Serial.clearCapture();
+  RPU_DumpSwitchEvents();
+  unsigned long dumpLength = (Serial.captureLength()<MAX_DUMP_LENGTH) ? Serial.captureLength() : MAX_DUMP_LENGTH;
+  memcpy(Run->dump, Serial.capture(), dumpLength);
+  Run->dump[dumpLength] = 0;
+  Run->recorded = CheckDump(Run->dump);
+}
+
+// The diagnostics page starts a replay as it goes back to the recorded
+// page, and this starts it as self-test brings the page up, with its
+// times from the page's marker like the recording's
+boolean ReplayNextPage(Trace *trace) {
+  EnterNextPage();
+  unsigned long markerTime = SwitchEventLastTime;
+  LoadDump(Run->dump);
+  byte startMarker = RPU_StartSwitchReplay();
+  if (startMarker!=(byte)Run->page) {
+    printf("FAIL: the replay starts on page %d, not %d\n", (signed char)startMarker, Run->page);
+    return false;
+  }
+  SwitchReplayNextTime -= millis() - markerTime;
+  StartTrace(trace, markerTime);
+  RunTracedUntil(trace, Run->duration);
+  if (RPU_IsSwitchReplayActive()) {
+    printf("FAIL: the replay on page %d is still running, %d events left\n", Run->page, RPU_GetSwitchReplayEventsLeft());
+    return false;
+  }
+  return true;
+}
+
+void ReplayNextPageInCopy(unsigned long unused) {
+  (void)unused;
+  Run->replayed = ReplayNextPage(&Run->copyReplay);
+}
+
+// Runs function in a copy of the simulation as it is now
+boolean InCopy(void (*function)(unsigned long), unsigned long argument) {
+  fflush(stdout);
+  pid_t copy = fork();
+  if (copy==0) {
+    function(argument);
+    fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  return copy>0 && waitpid(copy, &status, 0)==copy && WIFEXITED(status) && WEXITSTATUS(status)==0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long taps = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_TAPS;
+  if (taps>MAX_TAPS) taps = MAX_TAPS;
+  Run = (PageRun *)mmap(NULL, sizeof(PageRun), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if (Run==MAP_FAILED) {
+    printf("FAIL: no shared memory\n");
+    return 1;
+  }
+
+  HostPowerOn();
+  HostSetUpGame();
+  HostRunFor(1000);
+
+  printf("  page  events  changes  length ms  replay\n");
+  boolean passed = true;
+  byte pages = 0;
+  while (true) {
+    Run->recorded = false;
+    Run->replayed = false;
+    // Different taps on each page
+    randomSeed(pages + 1);
+    if (!InCopy(RecordNextPage, taps)) {
+      printf("FAIL: the recording didn't finish\n");
+      passed = false;
+      break;
+    }
+    if (!RecordedPage(Run->page)) break;
+
+    boolean pagePassed = Run->recorded && InCopy(ReplayNextPageInCopy, 0) && Run->replayed;
+    if (pagePassed) pagePassed = ReplayNextPage(&Replayed);
+    else EnterNextPage();
+    if (pagePassed) pagePassed = SameTrace("the replay", &Run->recording, &Replayed, TIME_TOLERANCE);
+    if (pagePassed) pagePassed = SameTrace("the second replay", &Replayed, &Run->copyReplay, 0);
+    printf("  %5d %7d %8lu %10lu  %s\n", Run->page, Run->events, Run->recording.count, Run->duration, pagePassed ? "same" : "different");
+    if (!pagePassed) passed = false;
+    pages += 1;
+  }
+  if (pages==0) {
+    printf("FAIL: self-test didn't reach a test page\n");
+    passed = false;
+  }
+
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+# Turns the sketch into a C++ file the way the Arduino IDE does: Arduino.h
+# first, then a prototype for every function ahead of the code.
+# Run with the sketch named twice (the first pass collects prototypes).
+
+function prototype(line) {
+  sub(/[ \t]*\{.*$/, "", line)
+  # Defaults stay on the definition
+  gsub(/[ \t]*=[^,)]*/, "", line)
+  return line ";"
+}
+
+NR==FNR {
+  if ($0 ~ /^[A-Za-z_][A-Za-z0-9_]*[ \t*]+[A-Za-z_][A-Za-z0-9_]*[ \t]*\([^;]*\)[ \t]*\{/ && $1 !~ /^(if|else|while|for|switch|return|do)$/) {
+    prototypes = prototypes prototype($0) "\n"
+  }
+  if ($0 ~ /^#include/) lastInclude = FNR
+  next
+}
+
+FNR==1 {
+  print "#include <Arduino.h>"
+  print "#line 1 \"" FILENAME "\""
+}
+
+{
+  print
+  if (FNR==lastInclude) {
+    printf "%s", prototypes
+    print "#line " (FNR + 1) " \"" FILENAME "\""
+  }
+}
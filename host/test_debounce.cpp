@@ -0,0 +1,125 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the vertical-counter switch debounce
+
+    Feeds random switch samples through DebounceSwitchByte and checks what
+    it reports against the rules it replaced or implements:
+
+    - with every switch at a length of 2, the (off, on, on) closures and
+      (off, on) starting closures of the old SwitchesMinus2 / SwitchesMinus1
+      / SwitchesNow code
+    - with a mix of lengths, a count of closed samples kept per switch
+
+      build/test_debounce [samples]
+
+ */
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+
+#define DEFAULT_SAMPLES     200000
+// Arch 1 without extended switches - five strobes of eight
+#define SWITCH_BYTES        5
+#ifndef RPU_OS_SWITCH_DEBOUNCE_PLANES
+#define RPU_OS_SWITCH_DEBOUNCE_PLANES   3
+#endif
+#define MAX_SAMPLES         ((1<<RPU_OS_SWITCH_DEBOUNCE_PLANES)-1)
+
+extern volatile byte SwitchesNow[];
+byte DebounceSwitchByte(byte switchByte, byte *startingClosures);
+
+// Switches that change on some samples and stay put on others, so both
+// bounces and long closures come up
+byte NextSample(byte lastSample) {
+  long kind = random(4);
+  if (kind==0) return (byte)random(256);
+  if (kind==1) return lastSample ^ (byte)(1<<random(8));
+  return lastSample;
+}
+
+boolean CheckAgainstOldRule(unsigned long samples) {
+  byte minus2[SWITCH_BYTES], minus1[SWITCH_BYTES], now[SWITCH_BYTES];
+  memset(minus2, 0, sizeof(minus2));
+  memset(minus1, 0, sizeof(minus1));
+  memset(now, 0, sizeof(now));
+  RPU_SetAllSwitchDebounce(2);
+
+  for (unsigned long count=0; count<samples; count++) {
+    byte switchByte = count%SWITCH_BYTES;
+    minus2[switchByte] = minus1[switchByte];
+    minus1[switchByte] = now[switchByte];
+    now[switchByte] = NextSample(now[switchByte]);
+
+    SwitchesNow[switchByte] = now[switchByte];
+    byte startingClosures;
+    byte validClosures = DebounceSwitchByte(switchByte, &startingClosures);
+    byte oldValidClosures = (now[switchByte] & minus1[switchByte]) & ~minus2[switchByte];
+    byte oldStartingClosures = now[switchByte] & ~minus1[switchByte];
+    if (validClosures!=oldValidClosures || startingClosures!=oldStartingClosures) {
+      printf("FAIL: sample %lu, byte %d (0x%02X 0x%02X 0x%02X): closures 0x%02X/0x%02X, starting 0x%02X/0x%02X\n",
+             count, switchByte, minus2[switchByte], minus1[switchByte], now[switchByte],
+             validClosures, oldValidClosures, startingClosures, oldStartingClosures);
+      return false;
+    }
+  }
+  printf("Length 2 matches (off, on, on) for %lu samples\n", samples);
+  return true;
+}
+
+boolean CheckLengths(unsigned long samples) {
+  byte length[SWITCH_BYTES*8], closedCount[SWITCH_BYTES*8];
+  byte now[SWITCH_BYTES];
+  memset(closedCount, 0, sizeof(closedCount));
+  memset(now, 0, sizeof(now));
+  for (byte switchNum=0; switchNum<SWITCH_BYTES*8; switchNum++) {
+    length[switchNum] = (byte)random(1, MAX_SAMPLES + 1);
+    RPU_SetSwitchDebounce(switchNum, length[switchNum]);
+  }
+  // Start from every switch open
+  for (byte switchByte=0; switchByte<SWITCH_BYTES; switchByte++) {
+    SwitchesNow[switchByte] = 0;
+    DebounceSwitchByte(switchByte, NULL);
+  }
+
+  for (unsigned long count=0; count<samples; count++) {
+    byte switchByte = count%SWITCH_BYTES;
+    now[switchByte] = NextSample(now[switchByte]);
+
+    // Counts stop at the most a length can be, and only reaching the
+    // length makes a closure
+    byte expectedClosures = 0, expectedStarting = 0;
+    for (byte bit=0; bit<8; bit++) {
+      byte switchNum = switchByte*8 + bit;
+      byte lastCount = closedCount[switchNum];
+      if (now[switchByte] & (1<<bit)) {
+        if (lastCount<MAX_SAMPLES) closedCount[switchNum] += 1;
+      } else {
+        closedCount[switchNum] = 0;
+      }
+      boolean reached = (closedCount[switchNum]==length[switchNum] && lastCount!=closedCount[switchNum]);
+      if (reached) expectedClosures |= (1<<bit);
+      else if (closedCount[switchNum]==1 && lastCount==0) expectedStarting |= (1<<bit);
+    }
+
+    SwitchesNow[switchByte] = now[switchByte];
+    byte startingClosures;
+    byte validClosures = DebounceSwitchByte(switchByte, &startingClosures);
+    if (validClosures!=expectedClosures || startingClosures!=expectedStarting) {
+      printf("FAIL: sample %lu, byte %d (0x%02X): closures 0x%02X/0x%02X, starting 0x%02X/0x%02X\n",
+             count, switchByte, now[switchByte], validClosures, expectedClosures, startingClosures, expectedStarting);
+      return false;
+    }
+  }
+  printf("Lengths of 1 to %d match a count per switch for %lu samples\n", MAX_SAMPLES, samples);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  unsigned long samples = (argc>1) ? strtoul(argv[1], NULL, 10) : DEFAULT_SAMPLES;
+  boolean passed = CheckAgainstOldRule(samples);
+  if (passed) passed = CheckLengths(samples);
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}
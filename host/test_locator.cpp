@@ -0,0 +1,114 @@
+/**************************************************************************
+ *     This file is part of the Pinball Test Unit.
+
+    Host simulation - the light test's lamp locator
+
+    Starts the locator on the light test page for every lamp in turn and
+    answers it the way someone looking for that lamp would: a click when
+    it's one of the lit lamps, otherwise the other switch (or, on the
+    second round, a double-click). Checks that the locator stops on the
+    lamp with it selected at level 1, and that the pass with the last
+    answer doesn't also act on it as a normal click or double-click.
+
+      build/test_locator
+
+ */
+
+#include "HostSim.h"
+#include "RPU_Config.h"
+#include "RPU.h"
+#include "PinballTestUnit.h"
+
+#define ANSWER_TIME         700   // ms for a click or double-click to be taken
+#define MAX_ANSWERS         10
+
+extern byte primarySwitch;
+extern byte secondarySwitch;
+extern byte LnumLamps;
+extern byte CurValue;
+extern byte lightLevel;
+extern boolean LocatorActive;
+extern byte LocatorLow;
+extern byte LocatorHigh;
+
+void Click() {
+  HostTapSwitch(primarySwitch, 50, ANSWER_TIME);
+}
+
+void DoubleClick() {
+  HostTapSwitch(primarySwitch, 50, 100);
+  HostTapSwitch(primarySwitch, 50, ANSWER_TIME);
+}
+
+// The other switch steps the level from flashing (5) through the lamp
+// shows to the locator
+boolean StartLampLocator() {
+  for (byte press=0; press<4; press++) HostTapSwitch(secondarySwitch, 50, ANSWER_TIME);
+  return LocatorActive && lightLevel==9 && CurValue==99;
+}
+
+// Holding the button steps through the lamps to all of them flashing
+boolean BackToAllLamps() {
+  HostSetSwitch(primarySwitch, true);
+  for (unsigned long elapsed=0; elapsed<60000 && CurValue!=99; elapsed++) HostRunFor(1);
+  HostSetSwitch(primarySwitch, false);
+  HostRunFor(ANSWER_TIME);
+  return CurValue==99 && lightLevel==5;
+}
+
+boolean FindLamp(byte lampNum, boolean doubleClickForNo) {
+  if (!StartLampLocator()) {
+    printf("FAIL: the locator didn't start (level %d, lamp %d)\n", lightLevel, CurValue);
+    return false;
+  }
+  const char *lastAnswer = "";
+  for (byte answer=0; answer<MAX_ANSWERS && LocatorActive; answer++) {
+    if (lampNum<=(LocatorLow + LocatorHigh)/2) {
+      lastAnswer = "click";
+      Click();
+    } else if (doubleClickForNo) {
+      lastAnswer = "double-click";
+      DoubleClick();
+    } else {
+      lastAnswer = "other switch";
+      HostTapSwitch(secondarySwitch, 50, ANSWER_TIME);
+    }
+  }
+  if (LocatorActive || LocatorLow!=lampNum || CurValue!=LocatorLow || lightLevel!=1) {
+    printf("FAIL: looking for lamp %d, the locator %s on %d after a %s, with lamp %d at level %d\n", lampNum,
+           LocatorActive ? "is still running" : "ended", LocatorLow, lastAnswer, CurValue, lightLevel);
+    return false;
+  }
+  if (!BackToAllLamps()) {
+    printf("FAIL: holding the button after lamp %d left lamp %d at level %d\n", lampNum, CurValue, lightLevel);
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  HostPowerOn();
+  HostSetUpGame();
+  HostRunFor(1000);
+
+  HostNextMachineState();
+  if (MachineState!=MACHINE_STATE_TEST_LAMPS) {
+    printf("FAIL: self-test went to page %d, not the light test\n", MachineState);
+    printf("FAIL\n");
+    return 1;
+  }
+  HostRunFor(1000);
+
+  boolean passed = true;
+  unsigned int found = 0;
+  for (byte round=0; round<2 && passed; round++) {
+    for (int lampNum=0; lampNum<=LnumLamps && passed; lampNum++) {
+      passed = FindLamp(lampNum, round==1);
+      if (passed) found += 1;
+    }
+  }
+  if (passed) printf("Found each of lamps 0-%d with the other switch and with a double-click (%u in all)\n", LnumLamps, found);
+
+  printf(passed ? "PASS\n" : "FAIL\n");
+  return passed ? 0 : 1;
+}